@@ -27,6 +27,16 @@ extern "C" {
 
 #include <netatom.lv2/endian.h>
 
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#elif defined(__SSSE3__)
+#	include <tmmintrin.h>
+#elif defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
 #include <lv2/lv2plug.in/ns/ext/atom/atom.h>
 #include <lv2/lv2plug.in/ns/ext/atom/forge.h>
 #include <lv2/lv2plug.in/ns/ext/urid/urid.h>
@@ -45,6 +55,56 @@ netatom_serialize(netatom_t *netatom, LV2_Atom *atom, size_t size_rx,
 NETATOM_API const LV2_Atom *
 netatom_deserialize(netatom_t *netatom, uint8_t *buf_tx, size_t size_tx);
 
+NETATOM_API uint8_t *
+netatom_serialize_shared(netatom_t *netatom, LV2_Atom *atom, size_t size_rx,
+	size_t *size_tx);
+
+NETATOM_API const LV2_Atom *
+netatom_deserialize_shared(netatom_t *netatom, uint8_t *buf_tx, size_t size_tx);
+
+typedef int (*netatom_sink_t)(void *data, const void *buf, size_t size);
+
+NETATOM_API int
+netatom_serialize_shared_sink(netatom_t *netatom, const LV2_Atom *atom,
+	netatom_sink_t sink, void *data, size_t *size_tx);
+
+NETATOM_API uint8_t *
+netatom_serialize_shared_into(netatom_t *netatom, const LV2_Atom *atom,
+	uint8_t *buf_tx, size_t size_rx, size_t *size_tx);
+
+NETATOM_API uint8_t *
+netatom_shared_pending(netatom_t *netatom, uint8_t *buf_tx, size_t size_rx,
+	uint32_t *base, size_t *size_tx);
+
+NETATOM_API int
+netatom_shared_append(netatom_t *netatom, uint32_t base, const uint8_t *buf_tx,
+	size_t size_tx);
+
+NETATOM_API void
+netatom_shared_rewind(netatom_t *netatom);
+
+NETATOM_API void
+netatom_shared_reset(netatom_t *netatom);
+
+NETATOM_API int
+netatom_batch_begin(netatom_t *netatom, uint8_t *buf_tx, size_t size_rx);
+
+NETATOM_API int
+netatom_batch_add(netatom_t *netatom, int64_t frames, const LV2_Atom *atom);
+
+NETATOM_API uint8_t *
+netatom_batch_end(netatom_t *netatom, size_t *size_tx);
+
+NETATOM_API uint8_t *
+netatom_serialize_sequence(netatom_t *netatom, const LV2_Atom_Sequence *seq,
+	uint8_t *buf_tx, size_t size_rx, size_t *size_tx);
+
+NETATOM_API int
+netatom_batch_deserialize(netatom_t *netatom, uint8_t *buf_tx, size_t size_tx);
+
+NETATOM_API const LV2_Atom *
+netatom_batch_next(netatom_t *netatom, int64_t *frames);
+
 NETATOM_API netatom_t *
 netatom_new(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool swap);
 
@@ -53,13 +113,70 @@ netatom_free(netatom_t *netatom);
 
 #ifdef NETATOM_IMPLEMENTATION
 
+#define NETATOM_STAGE_SIZE 512
+#define NETATOM_DICT_SLOTS 256 // power of 2
+#define NETATOM_DICT_FILL (NETATOM_DICT_SLOTS * 3 / 4)
+#define NETATOM_CACHE_SLOTS 256 // power of 2
+#define NETATOM_CACHE_URI 120 // longer URIs are not cached
+
 typedef union _netatom_union_t netatom_union_t;
+typedef struct _netatom_writer_t netatom_writer_t;
+typedef struct _netatom_slot_t netatom_slot_t;
+typedef struct _netatom_entry_t netatom_entry_t;
+typedef struct _netatom_shared_t netatom_shared_t;
+typedef struct _netatom_batch_t netatom_batch_t;
 
 union _netatom_union_t {
 	LV2_Atom *atom;
 	uint8_t *buf;
 };
 
+// serializes from a const source, either straight into an output buffer or
+// staged in small chunks to a sink
+struct _netatom_writer_t {
+	uint8_t *cur;
+	netatom_sink_t sink;
+	void *data;
+	size_t written;
+	size_t staged;
+	bool failed;
+	uint8_t stage [NETATOM_STAGE_SIZE];
+};
+
+// open addressing hash slot, maps URID to its dictionary reference
+struct _netatom_slot_t {
+	LV2_URID urid;
+	uint32_t ref;
+	uint32_t gen; // slot is empty unless of current generation
+};
+
+// cached URID <-> URI translation
+struct _netatom_entry_t {
+	LV2_URID urid; // 0 if empty
+	uint32_t hash;
+	char uri [NETATOM_CACHE_URI];
+};
+
+struct _netatom_shared_t {
+	LV2_URID *urids;
+	uint32_t n;
+	uint32_t max;
+	uint32_t pending;
+	bool active;
+	netatom_slot_t *slots; // twice as many as max urids
+};
+
+// events of a batch reference their own dictionary, appended to them:
+// count (32 bit), size of events (32 bit), events (frames (64 bit) plus atom),
+// dictionary entries
+struct _netatom_batch_t {
+	netatom_shared_t shared;
+	uint8_t *buf;
+	uint8_t *cur;
+	const uint8_t *end;
+	uint32_t count;
+};
+
 struct _netatom_t {
 	bool swap;
 	LV2_URID_Unmap *unmap;
@@ -69,28 +186,316 @@ struct _netatom_t {
 		uint8_t *buf;
 		const uint8_t *cur;
 		const uint8_t *end;
+		uint32_t gen; // bumped per serialize call, empties all slots at once
+		uint32_t n;
+		netatom_slot_t slots [NETATOM_DICT_SLOTS];
 	} dict;
+	netatom_shared_t shared;
+	netatom_batch_t batch;
+	struct {
+		netatom_entry_t *entries; // direct mapped by URID
+		uint16_t *by_hash; // entry index, direct mapped by URI hash
+	} cache;
 	uint32_t MIDI_MidiEvent;
 	bool overflow;
 };
 
+// byte swap runs of 32 bit elements to/from big endian, dst may equal src,
+// neither needs to be aligned
+static inline void
+_netatom_swap_32(void *dst, const void *src, size_t n)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t i = 0;
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#	if defined(__AVX2__)
+	const __m256i mask = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	for( ; i + 8 <= n; i += 8)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i *)&s[i*4]);
+		_mm256_storeu_si256((__m256i *)&d[i*4], _mm256_shuffle_epi8(v, mask));
+	}
+#	elif defined(__SSSE3__)
+	const __m128i mask = _mm_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	for( ; i + 4 <= n; i += 4)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *)&s[i*4]);
+		_mm_storeu_si128((__m128i *)&d[i*4], _mm_shuffle_epi8(v, mask));
+	}
+#	elif defined(__SSE2__)
+	for( ; i + 4 <= n; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)&s[i*4]);
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); // bytes
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1); // words
+		_mm_storeu_si128((__m128i *)&d[i*4], v);
+	}
+#	elif defined(__ARM_NEON)
+	for( ; i + 4 <= n; i += 4)
+		vst1q_u8(&d[i*4], vrev32q_u8(vld1q_u8(&s[i*4])));
+#	endif
+#endif
+
+	for( ; i < n; i++)
+	{
+		uint32_t u;
+		memcpy(&u, &s[i*4], sizeof(uint32_t));
+		u = htobe32(u);
+		memcpy(&d[i*4], &u, sizeof(uint32_t));
+	}
+}
+
+// byte swap runs of 64 bit elements to/from big endian, dst may equal src,
+// neither needs to be aligned
+static inline void
+_netatom_swap_64(void *dst, const void *src, size_t n)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t i = 0;
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#	if defined(__AVX2__)
+	const __m256i mask = _mm256_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	for( ; i + 4 <= n; i += 4)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i *)&s[i*8]);
+		_mm256_storeu_si256((__m256i *)&d[i*8], _mm256_shuffle_epi8(v, mask));
+	}
+#	elif defined(__SSSE3__)
+	const __m128i mask = _mm_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	for( ; i + 2 <= n; i += 2)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *)&s[i*8]);
+		_mm_storeu_si128((__m128i *)&d[i*8], _mm_shuffle_epi8(v, mask));
+	}
+#	elif defined(__SSE2__)
+	for( ; i + 2 <= n; i += 2)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)&s[i*8]);
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); // bytes
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1b), 0x1b); // words
+		_mm_storeu_si128((__m128i *)&d[i*8], v);
+	}
+#	elif defined(__ARM_NEON)
+	for( ; i + 2 <= n; i += 2)
+		vst1q_u8(&d[i*8], vrev64q_u8(vld1q_u8(&s[i*8])));
+#	endif
+#endif
+
+	for( ; i < n; i++)
+	{
+		uint64_t u;
+		memcpy(&u, &s[i*8], sizeof(uint64_t));
+		u = htobe64(u);
+		memcpy(&d[i*8], &u, sizeof(uint64_t));
+	}
+}
+
+static inline uint32_t
+_netatom_hash_uri(const char *uri)
+{
+	uint32_t hash = 0x811c9dc5U; // FNV-1a
+
+	for(const char *c = uri; *c; c++)
+	{
+		hash ^= (uint8_t)*c;
+		hash *= 0x01000193U;
+	}
+
+	return hash;
+}
+
+static inline uint32_t
+_netatom_hash(LV2_URID urid, uint32_t mask)
+{
+	return (urid * 0x9e3779b1U) & mask; // Fibonacci hashing, URIDs are dense
+}
+
+// returns slot of matching or first empty one
+static inline netatom_slot_t *
+_netatom_slot(netatom_slot_t *slots, uint32_t mask, uint32_t gen, LV2_URID urid)
+{
+	for(uint32_t i = _netatom_hash(urid, mask); ; i = (i + 1) & mask)
+	{
+		netatom_slot_t *slot = &slots[i];
+
+		if( (slot->gen != gen) || (slot->urid == urid) )
+			return slot;
+	}
+}
+
+static inline int
+_netatom_shared_grow(netatom_t *netatom)
+{
+	const uint32_t max = netatom->shared.max ? netatom->shared.max * 2 : 64;
+	LV2_URID *urids = realloc(netatom->shared.urids, max * sizeof(LV2_URID));
+	if(!urids)
+		return -1;
+	netatom->shared.urids = urids;
+
+	netatom_slot_t *slots = calloc(max * 2, sizeof(netatom_slot_t));
+	if(!slots)
+		return -1;
+	free(netatom->shared.slots);
+	netatom->shared.slots = slots;
+	netatom->shared.max = max;
+
+	// rehash, slots of shared dictionary are always of generation 1
+	for(uint32_t i = 0; i < netatom->shared.n; i++)
+	{
+		const LV2_URID urid = netatom->shared.urids[i];
+		netatom_slot_t *slot = _netatom_slot(slots, max * 2 - 1, 1, urid);
+
+		slot->urid = urid;
+		slot->ref = i + 1;
+		slot->gen = 1;
+	}
+
+	return 0;
+}
+
+static inline uint32_t
+_netatom_shared_ref(netatom_t *netatom, LV2_URID urid)
+{
+	// look for matching URID in shared dictionary
+	if(netatom->shared.slots)
+	{
+		const netatom_slot_t *slot = _netatom_slot(netatom->shared.slots,
+			netatom->shared.max * 2 - 1, 1, urid);
+
+		if(slot->gen == 1)
+			return slot->ref;
+	}
+
+	// add new URID to shared dictionary
+	if( (netatom->shared.n >= netatom->shared.max)
+		&& (_netatom_shared_grow(netatom) != 0) ) // dict buffer overflow
+	{
+		netatom->overflow = true;
+		return 0;
+	}
+
+	netatom_slot_t *slot = _netatom_slot(netatom->shared.slots,
+		netatom->shared.max * 2 - 1, 1, urid);
+	netatom->shared.urids[netatom->shared.n++] = urid;
+
+	slot->urid = urid;
+	slot->ref = netatom->shared.n;
+	slot->gen = 1;
+
+	return netatom->shared.n;
+}
+
+// evicts whatever entry the URID is direct mapped to
+static inline void
+_netatom_cache_put(netatom_t *netatom, LV2_URID urid, uint32_t hash,
+	const char *uri)
+{
+	const size_t len = strlen(uri);
+	if( (urid == 0) || (len >= NETATOM_CACHE_URI) )
+		return;
+
+	const uint32_t i = _netatom_hash(urid, NETATOM_CACHE_SLOTS - 1);
+	netatom_entry_t *entry = &netatom->cache.entries[i];
+
+	entry->urid = urid;
+	entry->hash = hash;
+	memcpy(entry->uri, uri, len + 1);
+
+	netatom->cache.by_hash[hash & (NETATOM_CACHE_SLOTS - 1)] = i;
+}
+
+// map through cache, host map is only reached on a miss
+static inline LV2_URID
+_netatom_map(netatom_t *netatom, const char *uri)
+{
+	const uint32_t hash = _netatom_hash_uri(uri);
+	const netatom_entry_t *entry = &netatom->cache.entries[
+		netatom->cache.by_hash[hash & (NETATOM_CACHE_SLOTS - 1)]];
+
+	if( entry->urid && (entry->hash == hash) && !strcmp(entry->uri, uri) )
+		return entry->urid;
+
+	const LV2_URID urid = netatom->map->map(netatom->map->handle, uri);
+	_netatom_cache_put(netatom, urid, hash, uri);
+
+	return urid;
+}
+
+// unmap through cache, returned URI is only valid up to the next (un)map
+static inline const char *
+_netatom_unmap(netatom_t *netatom, LV2_URID urid)
+{
+	const netatom_entry_t *entry = &netatom->cache.entries[
+		_netatom_hash(urid, NETATOM_CACHE_SLOTS - 1)];
+
+	if(entry->urid == urid)
+		return entry->uri;
+
+	const char *uri = netatom->unmap->unmap(netatom->unmap->handle, urid);
+	if(uri)
+		_netatom_cache_put(netatom, urid, _netatom_hash_uri(uri), uri);
+
+	return uri;
+}
+
+static inline void
+_netatom_dict_reset(netatom_t *netatom)
+{
+	netatom->dict.n = 0;
+
+	if(++netatom->dict.gen == 0) // wrapped around, stale slots may match again
+	{
+		memset(netatom->dict.slots, 0x0, sizeof(netatom->dict.slots));
+		netatom->dict.gen = 1;
+	}
+}
+
 static inline void
 _netatom_ser_uri(netatom_t *netatom, uint32_t *urid, const char *uri)
 {
 	if(*urid == 0)
 		return; // ignore untyped atoms
 
+	if(netatom->shared.active)
+	{
+		*urid = _netatom_shared_ref(netatom, *urid);
+
+		if(netatom->swap)
+			*urid = htobe32(*urid);
+
+		return;
+	}
+
 	// look for matching URID in dictionary
 	uint32_t match = 0;
+	netatom_slot_t *slot = _netatom_slot(netatom->dict.slots,
+		NETATOM_DICT_SLOTS - 1, netatom->dict.gen, *urid);
 
-	for(netatom_union_t ptr = { .buf = netatom->dict.buf };
-		ptr.buf < netatom->dict.cur;
-		ptr.buf += lv2_atom_pad_size(lv2_atom_total_size(ptr.atom)))
+	if(slot->gen == netatom->dict.gen)
 	{
-		if(ptr.atom->type == *urid)
+		match = slot->ref;
+	}
+	else if(netatom->dict.n >= NETATOM_DICT_FILL) // hash is full, scan the rest
+	{
+		for(netatom_union_t ptr = { .buf = netatom->dict.buf };
+			ptr.buf < netatom->dict.cur;
+			ptr.buf += lv2_atom_pad_size(lv2_atom_total_size(ptr.atom)))
 		{
-			match = ptr.buf - netatom->dict.buf + 1;
-			break;
+			if(ptr.atom->type == *urid)
+			{
+				match = ptr.buf - netatom->dict.buf + 1;
+				break;
+			}
 		}
 	}
 
@@ -101,7 +506,7 @@ _netatom_ser_uri(netatom_t *netatom, uint32_t *urid, const char *uri)
 	else // add new URI to dictionary
 	{
 		if(!uri)
-			uri = netatom->unmap->unmap(netatom->unmap->handle, *urid);
+			uri = _netatom_unmap(netatom, *urid);
 
 		if(!uri) // invalid urid
 		{
@@ -120,6 +525,14 @@ _netatom_ser_uri(netatom_t *netatom, uint32_t *urid, const char *uri)
 				atom->type = *urid;
 				strncpy(LV2_ATOM_BODY(atom), uri, tot_size); // automatic padding
 
+				if(netatom->dict.n < NETATOM_DICT_FILL)
+				{
+					slot->urid = *urid;
+					slot->ref = ref;
+					slot->gen = netatom->dict.gen;
+				}
+				netatom->dict.n += 1;
+
 				*urid = ref;
 				netatom->dict.cur += tot_size;
 			}
@@ -162,6 +575,21 @@ _netatom_deser_uri(netatom_t *netatom, uint32_t *urid)
 		? be32toh(*urid)
 		: *urid;
 
+	if(netatom->shared.active)
+	{
+		if(ref > netatom->shared.n) // unknown reference
+		{
+			*urid = 0;
+			netatom->overflow = true;
+		}
+		else
+		{
+			*urid = netatom->shared.urids[ref - 1];
+		}
+
+		return;
+	}
+
 	const LV2_Atom *atom = (const LV2_Atom *)&netatom->dict.buf[ref - 1];
 	*urid = atom->type;
 }
@@ -176,7 +604,7 @@ _netatom_deser_dict(netatom_t *netatom)
 		if(netatom->swap)
 			ptr.atom->size = be32toh(ptr.atom->size);
 		const char *uri = LV2_ATOM_BODY_CONST(ptr.atom);
-		ptr.atom->type = netatom->map->map(netatom->map->handle, uri);
+		ptr.atom->type = _netatom_map(netatom, uri);
 	}
 }
 
@@ -316,15 +744,13 @@ _netatom_ser_atom(netatom_t *netatom, LV2_Atom *atom)
 			{
 				const unsigned n = (vec->atom.size - sizeof(LV2_Atom_Vector_Body)) / 4;
 				uint32_t *u = LV2_ATOM_CONTENTS(LV2_Atom_Vector, atom);
-				for(unsigned i = 0; i < n; i++)
-					u[i] = htobe32(u[i]);
+				_netatom_swap_32(u, u, n);
 			}
 			else if(vec->body.child_size == 8)
 			{
 				const unsigned n = (vec->atom.size - sizeof(LV2_Atom_Vector_Body)) / 8;
 				uint64_t *u = LV2_ATOM_CONTENTS(LV2_Atom_Vector, atom);
-				for(unsigned i = 0; i < n; i++)
-					u[i] = htobe64(u[i]);
+				_netatom_swap_64(u, u, n);
 			}
 			vec->body.child_size = htobe32(vec->body.child_size);
 		}
@@ -428,20 +854,249 @@ _netatom_deser_atom(netatom_t *netatom, LV2_Atom *atom)
 			{
 				const unsigned n = (vec->atom.size - sizeof(LV2_Atom_Vector_Body)) / 4;
 				uint32_t *u = LV2_ATOM_CONTENTS(LV2_Atom_Vector, atom);
-				for(unsigned i = 0; i < n; i++)
-					u[i] = be32toh(u[i]);
+				_netatom_swap_32(u, u, n); // swapping is its own inverse
 			}
 			else if(vec->body.child_size == 8)
 			{
 				const unsigned n = (vec->atom.size - sizeof(LV2_Atom_Vector_Body)) / 8;
 				uint64_t *u = LV2_ATOM_CONTENTS(LV2_Atom_Vector, atom);
-				for(unsigned i = 0; i < n; i++)
-					u[i] = be64toh(u[i]);
+				_netatom_swap_64(u, u, n);
 			}
 		}
 	}
 }
 
+static inline void
+_netatom_flush(netatom_writer_t *writer)
+{
+	if(!writer->staged)
+		return;
+
+	if(writer->sink(writer->data, writer->stage, writer->staged) != 0)
+		writer->failed = true;
+	writer->staged = 0;
+}
+
+static inline void
+_netatom_put(netatom_writer_t *writer, const void *src, size_t size)
+{
+	writer->written += size;
+
+	if(writer->cur) // output buffer, bounds checked up front
+	{
+		memcpy(writer->cur, src, size);
+		writer->cur += size;
+		return;
+	}
+
+	if(!writer->sink || writer->failed) // only count
+		return;
+
+	if(writer->staged + size > NETATOM_STAGE_SIZE)
+		_netatom_flush(writer);
+
+	if(size > NETATOM_STAGE_SIZE) // large bodies bypass stage
+	{
+		if(writer->sink(writer->data, src, size) != 0)
+			writer->failed = true;
+		return;
+	}
+
+	memcpy(&writer->stage[writer->staged], src, size);
+	writer->staged += size;
+}
+
+static inline void
+_netatom_put_pad(netatom_writer_t *writer, uint32_t size)
+{
+	static const uint8_t zero [8];
+
+	_netatom_put(writer, zero, lv2_atom_pad_size(size) - size);
+}
+
+static inline void
+_netatom_put_32(netatom_t *netatom, netatom_writer_t *writer, uint32_t u)
+{
+	if(netatom->swap)
+		u = htobe32(u);
+	_netatom_put(writer, &u, sizeof(uint32_t));
+}
+
+static inline void
+_netatom_put_64(netatom_t *netatom, netatom_writer_t *writer, uint64_t u)
+{
+	if(netatom->swap)
+		u = htobe64(u);
+	_netatom_put(writer, &u, sizeof(uint64_t));
+}
+
+// byte swapped run of elements, straight into output buffer or stage
+static inline void
+_netatom_put_swapped(netatom_writer_t *writer, const void *src, size_t n,
+	size_t width)
+{
+	const uint8_t *cur = src;
+
+	if(writer->cur)
+	{
+		if(width == sizeof(uint64_t))
+			_netatom_swap_64(writer->cur, cur, n);
+		else
+			_netatom_swap_32(writer->cur, cur, n);
+		writer->cur += n * width;
+		writer->written += n * width;
+		return;
+	}
+
+	while(n)
+	{
+		size_t m = (NETATOM_STAGE_SIZE - writer->staged) / width;
+		if(m > n)
+			m = n;
+
+		if(!writer->sink || writer->failed) // only count
+		{
+			writer->written += n * width;
+			return;
+		}
+		else if(m == 0)
+		{
+			_netatom_flush(writer);
+			continue;
+		}
+
+		uint8_t *dst = &writer->stage[writer->staged];
+		if(width == sizeof(uint64_t))
+			_netatom_swap_64(dst, cur, m);
+		else
+			_netatom_swap_32(dst, cur, m);
+
+		writer->staged += m * width;
+		writer->written += m * width;
+		cur += m * width;
+		n -= m;
+	}
+}
+
+static inline void
+_netatom_put_uri(netatom_t *netatom, netatom_writer_t *writer, uint32_t urid)
+{
+	_netatom_ser_uri(netatom, &urid, NULL);
+	_netatom_put(writer, &urid, sizeof(uint32_t));
+}
+
+// same layout as _netatom_ser_atom produces in place, source stays untouched
+static void
+_netatom_put_atom(netatom_t *netatom, netatom_writer_t *writer,
+	const LV2_Atom *atom)
+{
+	LV2_Atom_Forge *forge = &netatom->forge;
+
+	_netatom_put_32(netatom, writer, atom->size);
+	_netatom_put_uri(netatom, writer, atom->type);
+
+	if(  (atom->type == forge->Bool)
+		|| (atom->type == forge->Int)
+		|| (atom->type == forge->Float) )
+	{
+		_netatom_put_32(netatom, writer, *(const uint32_t *)LV2_ATOM_BODY_CONST(atom));
+	}
+	else if( (atom->type == forge->Long)
+		|| (atom->type == forge->Double) )
+	{
+		_netatom_put_64(netatom, writer, *(const uint64_t *)LV2_ATOM_BODY_CONST(atom));
+	}
+	else if(atom->type == forge->URID)
+	{
+		_netatom_put_uri(netatom, writer, *(const uint32_t *)LV2_ATOM_BODY_CONST(atom));
+	}
+	else if(atom->type == forge->Literal)
+	{
+		const LV2_Atom_Literal *lit = (const LV2_Atom_Literal *)atom;
+		_netatom_put_uri(netatom, writer, lit->body.datatype);
+		_netatom_put_uri(netatom, writer, lit->body.lang);
+		_netatom_put(writer, LV2_ATOM_CONTENTS_CONST(LV2_Atom_Literal, atom),
+			atom->size - sizeof(LV2_Atom_Literal_Body));
+	}
+	else if(atom->type == forge->Object)
+	{
+		const LV2_Atom_Object *obj = (const LV2_Atom_Object *)atom;
+		_netatom_put_uri(netatom, writer, obj->body.id);
+		_netatom_put_uri(netatom, writer, obj->body.otype);
+		LV2_ATOM_OBJECT_FOREACH(obj, prop)
+		{
+			_netatom_put_uri(netatom, writer, prop->key);
+			_netatom_put_uri(netatom, writer, prop->context);
+			_netatom_put_atom(netatom, writer, &prop->value);
+			_netatom_put_pad(writer, prop->value.size);
+		}
+	}
+	else if(atom->type == forge->Tuple)
+	{
+		const LV2_Atom_Tuple *tup = (const LV2_Atom_Tuple *)atom;
+		LV2_ATOM_TUPLE_FOREACH(tup, item)
+		{
+			_netatom_put_atom(netatom, writer, item);
+			_netatom_put_pad(writer, item->size);
+		}
+	}
+	else if(atom->type == forge->Sequence)
+	{
+		const LV2_Atom_Sequence *seq = (const LV2_Atom_Sequence *)atom;
+		_netatom_put_uri(netatom, writer, seq->body.unit);
+		_netatom_put_32(netatom, writer, seq->body.pad);
+		LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+		{
+			_netatom_put_64(netatom, writer, ev->time.frames);
+			_netatom_put_atom(netatom, writer, &ev->body);
+			_netatom_put_pad(writer, ev->body.size);
+		}
+	}
+	else if(atom->type == forge->Vector)
+	{
+		const LV2_Atom_Vector *vec = (const LV2_Atom_Vector *)atom;
+		const uint32_t child_size = vec->body.child_size;
+		const uint32_t size = vec->atom.size - sizeof(LV2_Atom_Vector_Body);
+		const void *body = LV2_ATOM_CONTENTS_CONST(LV2_Atom_Vector, atom);
+		_netatom_put_32(netatom, writer, child_size);
+		_netatom_put_uri(netatom, writer, vec->body.child_type);
+		if(netatom->swap && ( (child_size == 4) || (child_size == 8) ) )
+		{
+			_netatom_put_swapped(writer, body, size / child_size, child_size);
+			_netatom_put(writer, (const uint8_t *)body + size - size % child_size,
+				size % child_size);
+		}
+		else
+		{
+			_netatom_put(writer, body, size);
+		}
+	}
+	else // String, Chunk, MIDI_MidiEvent, Path, URI and unknown types
+	{
+		_netatom_put(writer, LV2_ATOM_BODY_CONST(atom), atom->size);
+	}
+}
+
+static inline int
+_netatom_serialize_shared_writer(netatom_t *netatom, const LV2_Atom *atom,
+	netatom_writer_t *writer)
+{
+	netatom->shared.active = true;
+	netatom->overflow = false;
+
+	_netatom_put_atom(netatom, writer, atom);
+	_netatom_put_pad(writer, lv2_atom_total_size(atom));
+	if(writer->sink)
+		_netatom_flush(writer);
+
+	netatom->shared.active = false;
+
+	if(netatom->overflow || writer->failed)
+		return -1;
+
+	return 0;
+}
+
 NETATOM_API uint8_t *
 netatom_serialize(netatom_t *netatom, LV2_Atom *atom, size_t size_rx,
 	size_t *size_tx)
@@ -455,6 +1110,7 @@ netatom_serialize(netatom_t *netatom, LV2_Atom *atom, size_t size_rx,
 	netatom->dict.buf = buf_rx + tot_size;
 	netatom->dict.cur = netatom->dict.buf;
 	netatom->dict.end = buf_rx + size_rx;
+	_netatom_dict_reset(netatom);
 
 	netatom->overflow = false;
 
@@ -499,6 +1155,386 @@ netatom_deserialize(netatom_t *netatom, uint8_t *buf_tx, size_t size_tx)
 	return atom;
 }
 
+NETATOM_API uint8_t *
+netatom_serialize_shared(netatom_t *netatom, LV2_Atom *atom, size_t size_rx,
+	size_t *size_tx)
+{
+	if(!netatom || !atom)
+		return NULL;
+
+	const uint32_t tot_size = lv2_atom_pad_size(lv2_atom_total_size(atom));
+	if(tot_size > size_rx)
+		return NULL;
+
+	netatom->shared.active = true;
+	netatom->overflow = false;
+
+	_netatom_ser_atom(netatom, atom);
+
+	netatom->shared.active = false;
+
+	if(netatom->overflow)
+		return NULL;
+
+	if(size_tx)
+		*size_tx = tot_size;
+
+	return (uint8_t *)atom;
+}
+
+NETATOM_API const LV2_Atom *
+netatom_deserialize_shared(netatom_t *netatom, uint8_t *buf_tx, size_t size_tx)
+{
+	if(!netatom || !buf_tx || (size_tx < sizeof(LV2_Atom)) )
+		return NULL;
+
+	LV2_Atom *atom = (LV2_Atom *)buf_tx;
+
+	netatom->shared.active = true;
+	netatom->overflow = false;
+
+	_netatom_deser_atom(netatom, atom);
+
+	netatom->shared.active = false;
+
+	if(netatom->overflow)
+		return NULL;
+
+	return atom;
+}
+
+NETATOM_API int
+netatom_serialize_shared_sink(netatom_t *netatom, const LV2_Atom *atom,
+	netatom_sink_t sink, void *data, size_t *size_tx)
+{
+	if(!netatom || !atom)
+		return -1;
+
+	netatom_writer_t writer = {
+		.sink = sink,
+		.data = data
+	};
+
+	if(_netatom_serialize_shared_writer(netatom, atom, &writer) != 0)
+		return -1;
+
+	if(size_tx)
+		*size_tx = writer.written;
+
+	return 0;
+}
+
+NETATOM_API uint8_t *
+netatom_serialize_shared_into(netatom_t *netatom, const LV2_Atom *atom,
+	uint8_t *buf_tx, size_t size_rx, size_t *size_tx)
+{
+	if(!netatom || !atom || !buf_tx)
+		return NULL;
+
+	const uint32_t tot_size = lv2_atom_pad_size(lv2_atom_total_size(atom));
+	if(tot_size > size_rx)
+		return NULL;
+
+	netatom_writer_t writer = {
+		.cur = buf_tx
+	};
+
+	if(_netatom_serialize_shared_writer(netatom, atom, &writer) != 0)
+		return NULL;
+
+	if(size_tx)
+		*size_tx = writer.written;
+
+	return buf_tx;
+}
+
+NETATOM_API uint8_t *
+netatom_shared_pending(netatom_t *netatom, uint8_t *buf_tx, size_t size_rx,
+	uint32_t *base, size_t *size_tx)
+{
+	if(!netatom || !buf_tx)
+		return NULL;
+
+	uint8_t *cur = buf_tx;
+	const uint8_t *end = buf_tx + size_rx;
+
+	for(uint32_t i = netatom->shared.pending; i < netatom->shared.n; i++)
+	{
+		const char *uri = _netatom_unmap(netatom, netatom->shared.urids[i]);
+		if(!uri) // invalid urid
+			return NULL;
+
+		const uint32_t size = strlen(uri) + 1;
+		const uint32_t tot_size = sizeof(LV2_Atom) + lv2_atom_pad_size(size);
+
+		if(cur + tot_size > end) // dict buffer overflow
+			return NULL;
+
+		LV2_Atom *atom = (LV2_Atom *)cur;
+		atom->size = netatom->swap
+			? htobe32(size)
+			: size;
+		atom->type = 0;
+		strncpy(LV2_ATOM_BODY(atom), uri, tot_size - sizeof(LV2_Atom)); // automatic padding
+
+		cur += tot_size;
+	}
+
+	if(base)
+		*base = netatom->shared.pending;
+	if(size_tx)
+		*size_tx = cur - buf_tx;
+
+	netatom->shared.pending = netatom->shared.n;
+
+	return buf_tx;
+}
+
+NETATOM_API int
+netatom_shared_append(netatom_t *netatom, uint32_t base, const uint8_t *buf_tx,
+	size_t size_tx)
+{
+	if(!netatom || !buf_tx)
+		return -1;
+
+	const uint8_t *cur = buf_tx;
+	const uint8_t *end = buf_tx + size_tx;
+
+	for(uint32_t i = base; cur + sizeof(LV2_Atom) <= end; i++)
+	{
+		const LV2_Atom *atom = (const LV2_Atom *)cur;
+		const uint32_t size = netatom->swap
+			? be32toh(atom->size)
+			: atom->size;
+		const uint32_t tot_size = sizeof(LV2_Atom) + lv2_atom_pad_size(size);
+
+		if( (size == 0) || (cur + tot_size > end) )
+			return -1;
+
+		if(i > netatom->shared.n) // gap in dictionary
+			return -1;
+
+		if(i == netatom->shared.n) // skip already known entries
+		{
+			const char *uri = LV2_ATOM_BODY_CONST(atom);
+			if(uri[size - 1] != '\0')
+				return -1;
+
+			netatom->overflow = false;
+			const LV2_URID urid = _netatom_map(netatom, uri);
+			if(  (_netatom_shared_ref(netatom, urid) != i + 1)
+				|| netatom->overflow)
+			{
+				return -1;
+			}
+		}
+
+		cur += tot_size;
+	}
+
+	// entries read from a stream need not be written out again
+	if(netatom->shared.pending < netatom->shared.n)
+		netatom->shared.pending = netatom->shared.n;
+
+	return 0;
+}
+
+NETATOM_API void
+netatom_shared_rewind(netatom_t *netatom)
+{
+	if(!netatom)
+		return;
+
+	netatom->shared.pending = 0;
+}
+
+NETATOM_API void
+netatom_shared_reset(netatom_t *netatom)
+{
+	if(!netatom)
+		return;
+
+	netatom->shared.n = 0;
+	netatom->shared.pending = 0;
+
+	if(netatom->shared.slots)
+	{
+		memset(netatom->shared.slots, 0x0,
+			netatom->shared.max * 2 * sizeof(netatom_slot_t));
+	}
+}
+
+// batch dictionary takes the place of the shared one while batching
+static inline void
+_netatom_batch_swap(netatom_t *netatom)
+{
+	const netatom_shared_t shared = netatom->shared;
+	netatom->shared = netatom->batch.shared;
+	netatom->batch.shared = shared;
+}
+
+NETATOM_API int
+netatom_batch_begin(netatom_t *netatom, uint8_t *buf_tx, size_t size_rx)
+{
+	if(!netatom || !buf_tx || (size_rx < 2*sizeof(uint32_t)) )
+		return -1;
+
+	_netatom_batch_swap(netatom);
+	netatom_shared_reset(netatom);
+	_netatom_batch_swap(netatom);
+
+	netatom->batch.buf = buf_tx;
+	netatom->batch.cur = buf_tx + 2*sizeof(uint32_t);
+	netatom->batch.end = buf_tx + size_rx;
+	netatom->batch.count = 0;
+
+	return 0;
+}
+
+NETATOM_API int
+netatom_batch_add(netatom_t *netatom, int64_t frames, const LV2_Atom *atom)
+{
+	if(!netatom || !netatom->batch.buf || !atom)
+		return -1;
+
+	const size_t tot_size = sizeof(int64_t)
+		+ lv2_atom_pad_size(lv2_atom_total_size(atom));
+	if(netatom->batch.cur + tot_size > netatom->batch.end)
+		return -1;
+
+	netatom_writer_t writer = {
+		.cur = netatom->batch.cur
+	};
+
+	_netatom_batch_swap(netatom);
+	_netatom_put_64(netatom, &writer, frames);
+	const int res = _netatom_serialize_shared_writer(netatom, atom, &writer);
+	_netatom_batch_swap(netatom);
+
+	if(res != 0)
+		return -1;
+
+	netatom->batch.cur += tot_size;
+	netatom->batch.count += 1;
+
+	return 0;
+}
+
+NETATOM_API uint8_t *
+netatom_batch_end(netatom_t *netatom, size_t *size_tx)
+{
+	if(!netatom || !netatom->batch.buf)
+		return NULL;
+
+	uint8_t *buf_tx = netatom->batch.buf;
+	const uint32_t size = netatom->batch.cur - buf_tx - 2*sizeof(uint32_t);
+	netatom->batch.buf = NULL;
+
+	size_t size_dict;
+	_netatom_batch_swap(netatom);
+	const uint8_t *dict = netatom_shared_pending(netatom, netatom->batch.cur,
+		netatom->batch.end - netatom->batch.cur, NULL, &size_dict);
+	_netatom_batch_swap(netatom);
+
+	if(!dict)
+		return NULL;
+
+	uint32_t *head = (uint32_t *)buf_tx;
+	head[0] = netatom->swap ? htobe32(netatom->batch.count) : netatom->batch.count;
+	head[1] = netatom->swap ? htobe32(size) : size;
+
+	if(size_tx)
+		*size_tx = 2*sizeof(uint32_t) + size + size_dict;
+
+	return buf_tx;
+}
+
+NETATOM_API uint8_t *
+netatom_serialize_sequence(netatom_t *netatom, const LV2_Atom_Sequence *seq,
+	uint8_t *buf_tx, size_t size_rx, size_t *size_tx)
+{
+	if(!seq || (netatom_batch_begin(netatom, buf_tx, size_rx) != 0) )
+		return NULL;
+
+	LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+	{
+		if(netatom_batch_add(netatom, ev->time.frames, &ev->body) != 0)
+		{
+			netatom->batch.buf = NULL;
+			return NULL;
+		}
+	}
+
+	return netatom_batch_end(netatom, size_tx);
+}
+
+NETATOM_API int
+netatom_batch_deserialize(netatom_t *netatom, uint8_t *buf_tx, size_t size_tx)
+{
+	if(!netatom || !buf_tx || (size_tx < 2*sizeof(uint32_t)) )
+		return -1;
+
+	const uint32_t *head = (const uint32_t *)buf_tx;
+	const uint32_t size = netatom->swap ? be32toh(head[1]) : head[1];
+	if(size > size_tx - 2*sizeof(uint32_t))
+		return -1;
+
+	uint8_t *events = buf_tx + 2*sizeof(uint32_t);
+
+	_netatom_batch_swap(netatom);
+	netatom_shared_reset(netatom);
+	const int res = netatom_shared_append(netatom, 0, events + size,
+		size_tx - 2*sizeof(uint32_t) - size);
+	_netatom_batch_swap(netatom);
+
+	if(res != 0)
+		return -1;
+
+	netatom->batch.buf = NULL;
+	netatom->batch.cur = events;
+	netatom->batch.end = events + size;
+	netatom->batch.count = netatom->swap ? be32toh(head[0]) : head[0];
+
+	return 0;
+}
+
+NETATOM_API const LV2_Atom *
+netatom_batch_next(netatom_t *netatom, int64_t *frames)
+{
+	if(!netatom || netatom->batch.buf || !netatom->batch.count)
+		return NULL;
+
+	uint8_t *cur = netatom->batch.cur;
+	if(cur + sizeof(int64_t) + sizeof(LV2_Atom) > netatom->batch.end)
+		return NULL;
+
+	uint64_t *u = (uint64_t *)cur;
+	LV2_Atom *atom = (LV2_Atom *)&u[1];
+	const uint32_t size = netatom->swap ? be32toh(atom->size) : atom->size;
+	const size_t tot_size = sizeof(int64_t)
+		+ lv2_atom_pad_size(sizeof(LV2_Atom) + size);
+	if(cur + tot_size > netatom->batch.end)
+		return NULL;
+
+	netatom->batch.cur += tot_size;
+	netatom->batch.count -= 1;
+
+	if(frames)
+		*frames = netatom->swap ? (int64_t)be64toh(*u) : (int64_t)*u;
+
+	_netatom_batch_swap(netatom);
+	netatom->shared.active = true;
+	netatom->overflow = false;
+	_netatom_deser_atom(netatom, atom);
+	netatom->shared.active = false;
+	_netatom_batch_swap(netatom);
+
+	if(netatom->overflow)
+		return NULL;
+
+	return atom;
+}
+
 NETATOM_API netatom_t *
 netatom_new(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool swap)
 {
@@ -510,6 +1546,14 @@ netatom_new(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool swap)
 	netatom->map = map;
 	netatom->unmap = unmap;
 
+	netatom->cache.entries = calloc(NETATOM_CACHE_SLOTS, sizeof(netatom_entry_t));
+	netatom->cache.by_hash = calloc(NETATOM_CACHE_SLOTS, sizeof(uint16_t));
+	if(!netatom->cache.entries || !netatom->cache.by_hash)
+	{
+		netatom_free(netatom);
+		return NULL;
+	}
+
 	lv2_atom_forge_init(&netatom->forge, map);
 
 	netatom->MIDI_MidiEvent = map->map(map->handle, LV2_MIDI__MidiEvent);
@@ -523,6 +1567,19 @@ netatom_free(netatom_t *netatom)
 	if(!netatom)
 		return;
 
+	if(netatom->shared.urids)
+		free(netatom->shared.urids);
+	if(netatom->shared.slots)
+		free(netatom->shared.slots);
+	if(netatom->batch.shared.urids)
+		free(netatom->batch.shared.urids);
+	if(netatom->batch.shared.slots)
+		free(netatom->batch.shared.slots);
+	if(netatom->cache.entries)
+		free(netatom->cache.entries);
+	if(netatom->cache.by_hash)
+		free(netatom->cache.by_hash);
+
 	free(netatom);
 }
 
@@ -22,7 +22,7 @@
 #include <netatom.lv2/netatom.h>
 
 #define MAX_URIDS 2048
-#define MAX_BUF 4092
+#define MAX_BUF 0x10000
 
 typedef struct _urid_t urid_t;
 typedef struct _store_t store_t;
@@ -35,12 +35,14 @@ struct _urid_t {
 struct _store_t {
 	urid_t urids [MAX_URIDS];
 	LV2_URID urid;
+	unsigned calls; // of map and unmap
 };
 
 static LV2_URID
 _map(LV2_URID_Map_Handle instance, const char *uri)
 {
 	store_t *handle = instance;
+	handle->calls += 1;
 
 	urid_t *itm;
 	for(itm=handle->urids; itm->urid; itm++)
@@ -62,6 +64,7 @@ static const char *
 _unmap(LV2_URID_Unmap_Handle instance, LV2_URID urid)
 {
 	store_t *handle = instance;
+	handle->calls += 1;
 
 	for(urid_t *itm=handle->urids; itm->urid; itm++)
 	{
@@ -82,14 +85,20 @@ _freemap(store_t *handle)
 
 static void
 _netatom_test(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool swap,
-	const LV2_Atom *atom, unsigned iterations)
+	const LV2_Atom *atom, unsigned iterations, bool cached)
 {
 	static uint8_t buf [MAX_BUF];
+	store_t *store = map->handle;
+	unsigned calls = 0;
 	netatom_t *netatom = netatom_new(map, unmap, swap);
 	assert(netatom);
 
 	for(unsigned i = 0; i < iterations; i++)
 	{
+		// translations are cached after first iteration
+		if(i == 1)
+			calls = store->calls;
+
 		memcpy(buf, atom, lv2_atom_total_size(atom));
 
 		size_t size_tx = 0;
@@ -116,9 +125,257 @@ _netatom_test(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool swap,
 		assert(memcmp(atom, atom_rx, size_rx) == 0);
 	}
 
+	if(cached && (iterations > 1) )
+		assert(store->calls == calls);
+
 	netatom_free(netatom);
 }
 
+static void
+_netatom_shared_test(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool swap,
+	const LV2_Atom *atom, unsigned iterations)
+{
+	static uint8_t buf [MAX_BUF];
+	static uint8_t dict [MAX_BUF];
+	netatom_t *tx = netatom_new(map, unmap, swap);
+	assert(tx);
+	netatom_t *rx = netatom_new(map, unmap, swap);
+	assert(rx);
+
+	for(unsigned i = 0; i < iterations; i++)
+	{
+		memcpy(buf, atom, lv2_atom_total_size(atom));
+
+		size_t size_tx = 0;
+		uint8_t *buf_tx = netatom_serialize_shared(tx, (LV2_Atom *)buf, MAX_BUF, &size_tx);
+		assert(buf_tx);
+		assert(size_tx == lv2_atom_pad_size(lv2_atom_total_size(atom)));
+
+		uint32_t base = 0;
+		size_t size_dict = 0;
+		assert(netatom_shared_pending(tx, dict, MAX_BUF, &base, &size_dict));
+		if(i == 0)
+			assert( (base == 0) && (size_dict > 0) );
+		else // dictionary only grows on first iteration
+			assert(size_dict == 0);
+
+		assert(netatom_shared_append(rx, base, dict, size_dict) == 0);
+
+		const LV2_Atom *atom_rx = netatom_deserialize_shared(rx, buf_tx, size_tx);
+		assert(atom_rx);
+
+		const uint32_t size_rx = lv2_atom_total_size(atom_rx);
+
+		assert(size_rx == lv2_atom_total_size(atom));
+		assert(memcmp(atom, atom_rx, size_rx) == 0);
+	}
+
+	// replaying whole dictionary must be idempotent
+	uint32_t base = 0;
+	size_t size_dict = 0;
+	netatom_shared_rewind(tx);
+	assert(netatom_shared_pending(tx, dict, MAX_BUF, &base, &size_dict));
+	assert( (base == 0) && (size_dict > 0) );
+	assert(netatom_shared_append(rx, base, dict, size_dict) == 0);
+
+	// gaps in dictionary must be rejected
+	netatom_shared_reset(rx);
+	assert(netatom_shared_append(rx, 1, dict, size_dict) != 0);
+
+	netatom_free(tx);
+	netatom_free(rx);
+}
+
+typedef struct _sink_t sink_t;
+
+struct _sink_t {
+	uint8_t *buf;
+	size_t size;
+	size_t max;
+};
+
+static int
+_sink(void *data, const void *buf, size_t size)
+{
+	sink_t *sink = data;
+
+	if(sink->size + size > sink->max)
+		return -1;
+
+	memcpy(&sink->buf[sink->size], buf, size);
+	sink->size += size;
+
+	return 0;
+}
+
+static void
+_netatom_sink_test(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool swap,
+	const LV2_Atom *atom, unsigned iterations)
+{
+	const size_t tot_size = lv2_atom_pad_size(lv2_atom_total_size(atom));
+	uint8_t *orig = malloc(tot_size);
+	uint8_t *buf = malloc(tot_size);
+	uint8_t *dict = malloc(MAX_BUF);
+	sink_t sink = {
+		.buf = malloc(tot_size),
+		.max = tot_size
+	};
+	assert(orig && buf && dict && sink.buf);
+	memcpy(orig, atom, lv2_atom_total_size(atom));
+
+	netatom_t *tx = netatom_new(map, unmap, swap);
+	assert(tx);
+	netatom_t *rx = netatom_new(map, unmap, swap);
+	assert(rx);
+
+	for(unsigned i = 0; i < iterations; i++)
+	{
+		size_t size_tx = 0;
+		uint8_t *buf_tx = netatom_serialize_shared_into(tx, atom, buf, tot_size, &size_tx);
+		assert(buf_tx);
+		assert(size_tx == tot_size);
+
+		// output buffer too small
+		assert(!netatom_serialize_shared_into(tx, atom, buf, tot_size - 1, NULL));
+
+		// identical stream through sink, counting only without
+		sink.size = 0;
+		assert(netatom_serialize_shared_sink(tx, atom, _sink, &sink, &size_tx) == 0);
+		assert( (size_tx == tot_size) && (sink.size == tot_size) );
+		assert(memcmp(buf_tx, sink.buf, tot_size) == 0);
+		size_tx = 0;
+		assert(netatom_serialize_shared_sink(tx, atom, NULL, NULL, &size_tx) == 0);
+		assert(size_tx == tot_size);
+
+		// source is left untouched
+		assert(memcmp(atom, orig, lv2_atom_total_size(atom)) == 0);
+
+		uint32_t base = 0;
+		size_t size_dict = 0;
+		assert(netatom_shared_pending(tx, dict, MAX_BUF, &base, &size_dict));
+		assert(netatom_shared_append(rx, base, dict, size_dict) == 0);
+
+		const LV2_Atom *atom_rx = netatom_deserialize_shared(rx, buf_tx, size_tx);
+		assert(atom_rx);
+
+		const uint32_t size_rx = lv2_atom_total_size(atom_rx);
+
+		assert(size_rx == lv2_atom_total_size(atom));
+		assert(memcmp(atom, atom_rx, size_rx) == 0);
+	}
+
+	// failing sink
+	sink.size = 0;
+	sink.max = tot_size / 2;
+	assert(netatom_serialize_shared_sink(tx, atom, _sink, &sink, NULL) != 0);
+
+	netatom_free(tx);
+	netatom_free(rx);
+	free(sink.buf);
+	free(dict);
+	free(buf);
+	free(orig);
+}
+
+static void
+_netatom_batch_test(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool swap,
+	const LV2_Atom_Sequence *seq, unsigned iterations)
+{
+	static uint8_t buf [MAX_BUF];
+	static uint8_t tmp [MAX_BUF];
+	netatom_t *tx = netatom_new(map, unmap, swap);
+	assert(tx);
+	netatom_t *rx = netatom_new(map, unmap, swap);
+	assert(rx);
+
+	// separately serialized events each carry their own dictionary
+	size_t size_single = 0;
+	LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+	{
+		memcpy(tmp, &ev->body, lv2_atom_total_size(&ev->body));
+
+		size_t size_tx = 0;
+		assert(netatom_serialize(tx, (LV2_Atom *)tmp, MAX_BUF, &size_tx));
+		size_single += sizeof(int64_t) + size_tx;
+	}
+
+	for(unsigned i = 0; i < iterations; i++)
+	{
+		size_t size_tx = 0;
+		uint8_t *buf_tx = netatom_serialize_sequence(tx, seq, buf, MAX_BUF, &size_tx);
+		assert(buf_tx);
+		assert(size_tx < size_single);
+
+		// event by event yields the same
+		size_t size_iter = 0;
+		assert(netatom_batch_begin(tx, tmp, MAX_BUF) == 0);
+		LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+		{
+			assert(netatom_batch_add(tx, ev->time.frames, &ev->body) == 0);
+		}
+		assert(netatom_batch_end(tx, &size_iter) == tmp);
+		assert( (size_iter == size_tx) && (memcmp(tmp, buf_tx, size_tx) == 0) );
+
+		assert(netatom_batch_deserialize(rx, buf_tx, size_tx) == 0);
+
+		int64_t frames;
+		LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+		{
+			const LV2_Atom *atom_rx = netatom_batch_next(rx, &frames);
+			assert(atom_rx);
+			assert(frames == ev->time.frames);
+
+			const uint32_t size_rx = lv2_atom_total_size(atom_rx);
+			assert(size_rx == lv2_atom_total_size(&ev->body));
+			assert(memcmp(&ev->body, atom_rx, size_rx) == 0);
+		}
+		assert(!netatom_batch_next(rx, &frames));
+	}
+
+	// too small output buffer
+	assert(!netatom_serialize_sequence(tx, seq, buf, 64, NULL));
+
+	netatom_free(tx);
+	netatom_free(rx);
+}
+
+static void
+_netatom_swap_test(void)
+{
+	uint32_t src32 [67], dst32 [67];
+	uint64_t src64 [67], dst64 [67];
+
+	for(unsigned i = 0; i < 67; i++)
+	{
+		src32[i] = 0x01020304U * (i + 1);
+		src64[i] = 0x0102030405060708ULL * (i + 1);
+	}
+
+	// all lengths around vector widths, elements past n untouched
+	for(unsigned n = 0; n < 66; n++)
+	{
+		memset(dst32, 0xff, sizeof(dst32));
+		memset(dst64, 0xff, sizeof(dst64));
+
+		_netatom_swap_32(dst32, src32, n);
+		_netatom_swap_64(dst64, src64, n);
+
+		for(unsigned i = 0; i < n; i++)
+		{
+			assert(dst32[i] == htobe32(src32[i]));
+			assert(dst64[i] == htobe64(src64[i]));
+		}
+		assert(dst32[n] == UINT32_MAX);
+		assert(dst64[n] == UINT64_MAX);
+
+		// in place back again
+		_netatom_swap_32(dst32, dst32, n);
+		_netatom_swap_64(dst64, dst64, n);
+		assert(memcmp(dst32, src32, n * sizeof(uint32_t)) == 0);
+		assert(memcmp(dst64, src64, n * sizeof(uint64_t)) == 0);
+	}
+}
+
 static void
 _sratom_test(LV2_URID_Map *map, LV2_URID_Unmap *unmap, bool pretty,
 	const LV2_Atom *atom, unsigned iterations)
@@ -258,6 +515,79 @@ main(int argc, char **argv)
 	}
 	lv2_atom_forge_pop(&forge, &obj_frame);
 
+	// object with more distinct URIDs than fit the dictionary hash
+	static union {
+		LV2_Atom atom;
+		uint8_t buf [0x4000];
+	} wide;
+
+	lv2_atom_forge_set_buffer(&forge, wide.buf, sizeof(wide.buf));
+	lv2_atom_forge_object(&forge, &obj_frame, 0, MAP("otype"));
+	for(int i = 0; i < 320; i++)
+	{
+		char key [32];
+		snprintf(key, sizeof(key), "urn:netatom:wide#%i", i);
+		lv2_atom_forge_key(&forge, map.map(map.handle, key));
+		lv2_atom_forge_int(&forge, i);
+	}
+	lv2_atom_forge_pop(&forge, &obj_frame);
+
+	// sequence of assorted events
+	static union {
+		LV2_Atom_Sequence seq;
+		uint8_t buf [0xc000];
+	} batch;
+
+	LV2_Atom_Forge_Frame seq_frame;
+	lv2_atom_forge_set_buffer(&forge, batch.buf, sizeof(batch.buf));
+	lv2_atom_forge_sequence_head(&forge, &seq_frame, 0);
+	for(int i = 0; i < 64; i++)
+	{
+		const uint8_t m [3] = {0x90, i, 0x7f};
+
+		lv2_atom_forge_frame_time(&forge, i * 64);
+		switch(i % 4)
+		{
+			case 0:
+				lv2_atom_forge_int(&forge, i);
+				break;
+			case 1:
+				lv2_atom_forge_atom(&forge, 3, map.map(map.handle, LV2_MIDI__MidiEvent));
+				lv2_atom_forge_write(&forge, m, 3);
+				break;
+			case 2:
+				lv2_atom_forge_urid(&forge, MAP("key"));
+				break;
+			case 3:
+				lv2_atom_forge_write(&forge, &un.atom, lv2_atom_total_size(&un.atom));
+				break;
+		}
+	}
+	{
+		// long vectors of odd length, as swapped in runs
+		float f [501];
+		for(int i = 0; i < 501; i++)
+			f[i] = i * 0.5f;
+		lv2_atom_forge_frame_time(&forge, 4096);
+		lv2_atom_forge_vector(&forge, sizeof(float), forge.Float, 501, f);
+
+		double d [251];
+		for(int i = 0; i < 251; i++)
+			d[i] = i * 0.25;
+		lv2_atom_forge_frame_time(&forge, 4096);
+		lv2_atom_forge_vector(&forge, sizeof(double), forge.Double, 251, d);
+	}
+	lv2_atom_forge_pop(&forge, &seq_frame);
+
+	// chunk beyond any fixed size serialization buffer
+	const uint32_t big_size = 0x4000;
+	LV2_Atom *big = calloc(1, sizeof(LV2_Atom) + big_size);
+	assert(big);
+	big->size = big_size;
+	big->type = forge.Chunk;
+	for(unsigned i = 0; i < big_size; i++)
+		((uint8_t *)LV2_ATOM_BODY(big))[i] = i;
+
 	// add some dummy URI to hash map
 	char tmp [32];
 	for(int i=0; i<1024; i++)
@@ -270,10 +600,22 @@ main(int argc, char **argv)
 	struct timespec t0, t1, t2;
 	clock_gettime(CLOCK_MONOTONIC, &t0);
 #endif
-	_netatom_test(&map, &unmap, true, &un.atom, iterations);
+	_netatom_test(&map, &unmap, true, &un.atom, iterations, true);
 #if !defined(__APPLE__) && !defined(_WIN32)
 	clock_gettime(CLOCK_MONOTONIC, &t1);
 #endif
+	_netatom_shared_test(&map, &unmap, true, &un.atom, iterations);
+	_netatom_shared_test(&map, &unmap, false, &un.atom, iterations);
+	_netatom_sink_test(&map, &unmap, true, &un.atom, iterations);
+	_netatom_sink_test(&map, &unmap, false, &un.atom, iterations);
+	_netatom_sink_test(&map, &unmap, true, big, 1);
+	_netatom_test(&map, &unmap, true, &wide.atom, 2, false); // exceeds cache
+	_netatom_shared_test(&map, &unmap, true, &wide.atom, 2);
+	_netatom_swap_test();
+	_netatom_batch_test(&map, &unmap, true, &batch.seq, iterations);
+	_netatom_test(&map, &unmap, true, &batch.seq.atom, iterations, true);
+	_netatom_sink_test(&map, &unmap, true, &batch.seq.atom, iterations);
+	_netatom_batch_test(&map, &unmap, false, &batch.seq, iterations);
 	_sratom_test(&map, &unmap, false, &un.atom, iterations);
 #if !defined(__APPLE__) && !defined(_WIN32)
 	clock_gettime(CLOCK_MONOTONIC, &t2);
@@ -283,6 +625,7 @@ main(int argc, char **argv)
 	fprintf(stderr, "%lf s, %lf s, x %lf\n", d1, d2, d2/d1);
 #endif
 
+	free(big);
 	_freemap(&handle);
 
 	return 0;
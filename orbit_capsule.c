@@ -0,0 +1,1347 @@
+/*
+ * Copyright (c) 2015-2016 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+// offline inspection and conversion of timecapsule recordings
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include <zlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#define NETATOM_IMPLEMENTATION
+#define NETATOM_API static inline // only part of the API is used here
+#include <netatom.lv2/netatom.h>
+
+#include <orbit_capsule.h>
+
+#define MAX_URIDS 2048
+#define MAX_BUF BLOCK_SIZE
+#define ZBUF_SIZE 0x10000
+#define PPQN 960 // ticks per quarter note of exported MIDI files
+
+typedef struct _urid_t urid_t;
+typedef struct _store_t store_t;
+typedef struct _reader_t reader_t;
+typedef struct _writer_t writer_t;
+typedef struct _midi_t midi_t;
+
+struct _urid_t {
+	LV2_URID urid;
+	char *uri;
+};
+
+// stub URID map, only lives as long as the tool runs
+struct _store_t {
+	urid_t urids [MAX_URIDS];
+	LV2_URID urid;
+	LV2_URID_Map map;
+	LV2_URID_Unmap unmap;
+	LV2_URID midi_event;
+};
+
+// sequential reader of items, dictionary entries are parsed on the fly,
+// blocks are read in order of index, if any, wherever they lie in the file
+struct _reader_t {
+	int fd;
+	gzFile gzfile;
+	netatom_t *netatom;
+	bool has_header;
+	bool pending; // header has been read ahead
+	header_t header;
+	bool has_footer;
+	footer_t footer;
+	double beats;
+	uint32_t flags;
+	uint8_t buf [MAX_BUF];
+
+	struct {
+		size_t n;
+		entry_t *entries;
+		size_t blk; // being read
+		uint32_t left; // events of it not read yet
+	} index;
+};
+
+// writes blocks as independent gzip members followed by index and footer,
+// like the plugin does
+struct _writer_t {
+	int fd;
+	bool raw;
+	z_stream strm;
+	netatom_t *netatom;
+	uint64_t offset;
+	uint64_t events;
+	double last;
+
+	struct {
+		double beats;
+		size_t size;
+		uint32_t count;
+		uint32_t tracks;
+		uint8_t buf [BLOCK_SIZE];
+	} blk;
+
+	struct {
+		size_t n;
+		size_t max;
+		entry_t *entries;
+	} index;
+
+	uint8_t dict [MAX_DICT];
+	uint8_t zbuf [ZBUF_SIZE];
+};
+
+struct _midi_t {
+	uint64_t tick;
+	size_t order; // keeps merged tracks stable
+	uint32_t size;
+	uint8_t *body;
+};
+
+static const char *usage =
+	"usage: orbit_capsule [-c LEVEL] [-r RATE] COMMAND FILE [FILE]\n"
+	"\n"
+	"commands:\n"
+	"  list CAPSULE             print all items, events with their track\n"
+	"  stats CAPSULE            print header and footer summary\n"
+	"  export CAPSULE MIDI      convert MIDI events to Standard MIDI File\n"
+	"  import MIDI CAPSULE      convert Standard MIDI File to capsule\n"
+	"  convert CAPSULE CAPSULE  re-encode, e.g. at another compression level\n"
+	"\n"
+	"options:\n"
+	"  -c LEVEL  compression of written capsules, 0 (none) to 3 (best), default 3\n"
+	"  -r RATE   sample rate stored with imported MIDI files, default 0 (unknown)\n";
+
+static LV2_URID
+_map(LV2_URID_Map_Handle instance, const char *uri)
+{
+	store_t *handle = instance;
+
+	urid_t *itm;
+	for(itm=handle->urids; itm->urid; itm++)
+	{
+		if(!strcmp(itm->uri, uri))
+			return itm->urid;
+	}
+
+	if(handle->urid + 1 >= MAX_URIDS)
+		return 0;
+
+	// create new
+	itm->urid = ++handle->urid;
+	itm->uri = strdup(uri);
+
+	return itm->urid;
+}
+
+static const char *
+_unmap(LV2_URID_Unmap_Handle instance, LV2_URID urid)
+{
+	store_t *handle = instance;
+
+	for(urid_t *itm=handle->urids; itm->urid; itm++)
+	{
+		if(itm->urid == urid)
+			return itm->uri;
+	}
+
+	// not found
+	return NULL;
+}
+
+static void
+_store_init(store_t *handle)
+{
+	handle->map.handle = handle;
+	handle->map.map = _map;
+	handle->unmap.handle = handle;
+	handle->unmap.unmap = _unmap;
+	handle->midi_event = _map(handle, LV2_MIDI__MidiEvent);
+}
+
+static void
+_store_deinit(store_t *handle)
+{
+	for(urid_t *itm = handle->urids; itm->urid; itm++)
+		free(itm->uri);
+}
+
+// restart decompression at given file offset
+static int
+_reader_seek(reader_t *reader, off_t offset)
+{
+	if(reader->gzfile)
+		gzclose(reader->gzfile);
+
+	reader->gzfile = (lseek(reader->fd, offset, SEEK_SET) != -1)
+		? gzdopen(dup(reader->fd), "rb")
+		: NULL;
+	if(!reader->gzfile)
+		return -1;
+
+	gzbuffer(reader->gzfile, ZBUF_SIZE);
+
+	return 0;
+}
+
+// load seek index and complete shared dictionary, blocks of recordings
+// punched into need not be stored in order, nor do they define dictionary
+// entries in order
+static int
+_reader_index(reader_t *reader)
+{
+	const uint32_t version = be32toh(reader->footer.version);
+	const off_t index = be64toh(reader->footer.index);
+	if( (version < 1) || (version > FORMAT_VERSION) || (_reader_seek(reader, index) != 0) )
+		return -1;
+
+	item_t itm;
+	uint32_t n;
+	if(  (gzfread(&itm, sizeof(item_t), 1, reader->gzfile) != 1)
+		|| (itm.size != 0)
+		|| (gzfread(&n, sizeof(uint32_t), 1, reader->gzfile) != 1) )
+		return -1;
+
+	n = be32toh(n);
+	reader->index.entries = calloc(n ? n : 1, sizeof(entry_t));
+	if(!reader->index.entries)
+		return -1;
+
+	const size_t entry_size = _entry_size(version);
+	for(uint32_t i = 0; i < n; i++)
+	{
+		entry_t entry = {
+			.size = 0
+		};
+		if(gzfread(&entry, entry_size, 1, reader->gzfile) != 1)
+			return -1;
+
+		entry_t *dst = &reader->index.entries[i];
+		dst->beats = _double_from_be(&entry.beats);
+		dst->offset = be64toh(entry.offset);
+		dst->count = be32toh(entry.count);
+		dst->size = be32toh(entry.size);
+	}
+
+	// legacy blocks lie back to back
+	for(uint32_t i = 0; i < n; i++)
+	{
+		entry_t *entry = &reader->index.entries[i];
+
+		if(entry->size == 0)
+			entry->size = ( (i + 1 < n) ? entry[1].offset : (uint64_t)index) - entry->offset;
+	}
+
+	reader->index.n = n;
+
+	// legacy indices may come without dictionary
+	uint32_t dict_size;
+	if(gzfread(&dict_size, sizeof(uint32_t), 1, reader->gzfile) == 1)
+	{
+		uint32_t base;
+		dict_size = be32toh(dict_size);
+
+		if(  (dict_size < sizeof(uint32_t)) || (dict_size > MAX_DICT)
+			|| (gzfread(reader->buf, dict_size, 1, reader->gzfile) != 1) )
+			return -1;
+
+		memcpy(&base, reader->buf, sizeof(uint32_t));
+		if(netatom_shared_append(reader->netatom, be32toh(base),
+			reader->buf + sizeof(uint32_t), dict_size - sizeof(uint32_t)) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int
+_reader_open(reader_t *reader, store_t *store, const char *path)
+{
+	memset(reader, 0x0, sizeof(reader_t));
+
+	reader->fd = open(path, O_RDONLY | O_BINARY);
+	if(reader->fd == -1)
+	{
+		fprintf(stderr, "failed to open '%s': %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	uint8_t tail [sizeof(footer_t) + GZIP_TRAILER_SIZE];
+	const off_t size = lseek(reader->fd, 0, SEEK_END);
+	if(  (size >= (off_t)sizeof(tail))
+		&& (pread(reader->fd, tail, sizeof(tail), size - sizeof(tail)) == sizeof(tail))
+		&& (_footer_find(tail, &reader->footer) == 0) )
+	{
+		reader->has_footer = true;
+	}
+
+	reader->netatom = netatom_new(&store->map, &store->unmap, true);
+	if(!reader->netatom)
+	{
+		fprintf(stderr, "failed to initialize reader for '%s'\n", path);
+		return -1;
+	}
+
+	if(reader->has_footer && (_reader_index(reader) != 0) )
+	{
+		fprintf(stderr, "invalid index of '%s'\n", path);
+		return -1;
+	}
+
+	if(_reader_seek(reader, 0) != 0)
+	{
+		fprintf(stderr, "failed to initialize reader for '%s'\n", path);
+		return -1;
+	}
+
+	if(reader->index.n)
+	{
+		// header is first item, if any, blocks follow in order of index
+		item_t itm;
+		if(  (gzfread(&itm, sizeof(item_t), 1, reader->gzfile) == 1)
+			&& (be32toh(itm.size) == (sizeof(header_t) | ITEM_FLAG_META))
+			&& (gzfread(&reader->header, sizeof(header_t), 1, reader->gzfile) == 1)
+			&& !memcmp(reader->header.magic, magic, MAGIC_SIZE) )
+		{
+			reader->has_header = true;
+			reader->pending = true;
+		}
+
+		reader->index.blk = 0;
+		reader->index.left = reader->index.entries[0].count;
+		if(_reader_seek(reader, reader->index.entries[0].offset) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+// continue with next block holding events, once current one has been read
+static int
+_reader_advance(reader_t *reader)
+{
+	const entry_t *entries = reader->index.entries;
+	const size_t n = reader->index.n;
+	size_t k = reader->index.blk;
+	bool detached = false;
+
+	if(k >= n)
+		return 0; // behind last block
+
+	do
+	{
+		k += 1;
+		detached = detached || ( (k < n) && _entry_detached(entries, k) );
+	} while( (k < n) && (entries[k].count == 0) );
+
+	reader->index.blk = k;
+	reader->index.left = (k < n) ? entries[k].count : 0;
+
+	return ( (k < n) && detached) ? _reader_seek(reader, entries[k].offset) : 0;
+}
+
+static void
+_reader_close(reader_t *reader)
+{
+	if(reader->netatom)
+		netatom_free(reader->netatom);
+	if(reader->gzfile)
+		gzclose(reader->gzfile);
+	free(reader->index.entries);
+	if(reader->fd != -1)
+		close(reader->fd);
+}
+
+// read next item into buffer, returns 1 at end of data
+static int
+_reader_next(reader_t *reader, uint32_t *size)
+{
+	if(reader->pending)
+	{
+		reader->pending = false;
+		reader->beats = 0.0;
+		reader->flags = sizeof(header_t) | ITEM_FLAG_META;
+		*size = sizeof(header_t);
+		memcpy(reader->buf, &reader->header, sizeof(header_t));
+
+		return 0;
+	}
+
+	if(reader->index.n && !reader->index.left && (_reader_advance(reader) != 0) )
+	{
+		fprintf(stderr, "failed to seek to block %zu\n", reader->index.blk);
+		return -1;
+	}
+
+	item_t itm;
+	if(gzfread(&itm, sizeof(item_t), 1, reader->gzfile) != 1)
+		return 1;
+
+	itm.beats.u = be64toh(itm.beats.u);
+	itm.size = be32toh(itm.size);
+
+	if(itm.size == 0) // end-of-data marker in front of index
+		return 1;
+
+	if(ITEM_IS_EVENT(itm.size) && reader->index.left)
+		reader->index.left -= 1;
+
+	reader->beats = itm.beats.d;
+	reader->flags = itm.size;
+	*size = ITEM_SIZE(itm.size);
+
+	if( (*size > MAX_BUF) || (gzfread(reader->buf, *size, 1, reader->gzfile) != 1) )
+	{
+		fprintf(stderr, "truncated item at %lf\n", reader->beats);
+		return -1;
+	}
+
+	if(reader->flags & ITEM_FLAG_DICT)
+	{
+		uint32_t base;
+		memcpy(&base, reader->buf, sizeof(uint32_t));
+
+		if( (*size < sizeof(uint32_t))
+			|| (netatom_shared_append(reader->netatom, be32toh(base),
+				reader->buf + sizeof(uint32_t), *size - sizeof(uint32_t)) != 0) )
+		{
+			fprintf(stderr, "invalid dictionary at %lf\n", reader->beats);
+			return -1;
+		}
+	}
+	else if( (reader->flags & ITEM_FLAG_META) && (*size == sizeof(header_t))
+		&& !memcmp(reader->buf, magic, MAGIC_SIZE) )
+	{
+		memcpy(&reader->header, reader->buf, sizeof(header_t));
+		reader->has_header = true;
+	}
+
+	return 0;
+}
+
+// deserialize event item just read
+static const LV2_Atom *
+_reader_atom(reader_t *reader, uint32_t size)
+{
+	return (reader->flags & ITEM_FLAG_SHARED)
+		? netatom_deserialize_shared(reader->netatom, reader->buf, size)
+		: netatom_deserialize(reader->netatom, reader->buf, size);
+}
+
+static int
+_writer_member(writer_t *writer, const void *buf, size_t size)
+{
+	if(writer->raw)
+	{
+		if(write(writer->fd, buf, size) != (ssize_t)size)
+			return -1;
+
+		writer->offset += size;
+
+		return 0;
+	}
+
+	z_stream *strm = &writer->strm;
+
+	strm->next_in = (Bytef *)buf;
+	strm->avail_in = size;
+
+	do
+	{
+		strm->next_out = writer->zbuf;
+		strm->avail_out = ZBUF_SIZE;
+
+		if(deflate(strm, Z_FINISH) == Z_STREAM_ERROR)
+			return -1;
+
+		const size_t len = ZBUF_SIZE - strm->avail_out;
+		if(write(writer->fd, writer->zbuf, len) != (ssize_t)len)
+			return -1;
+
+		writer->offset += len;
+	} while(strm->avail_out == 0);
+
+	deflateReset(strm);
+
+	return 0;
+}
+
+static int
+_writer_open(writer_t *writer, store_t *store, const char *path,
+	compression_t compression, uint32_t rate, double bpm)
+{
+	writer->fd = open(path, O_CREAT | O_TRUNC | O_WRONLY | O_BINARY, 0644);
+	if(writer->fd == -1)
+	{
+		fprintf(stderr, "failed to open '%s': %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	writer->raw = compression == TC_COMPRESSION_NONE;
+	writer->last = -INFINITY;
+
+	if(  !writer->raw
+		&& (deflateInit2(&writer->strm, writing_levels[compression],
+			Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) )
+	{
+		fprintf(stderr, "deflateInit2 failed\n");
+		return -1;
+	}
+
+	writer->netatom = netatom_new(&store->map, &store->unmap, true);
+	if(!writer->netatom)
+		return -1;
+
+	struct {
+		item_t itm;
+		header_t header;
+	} __attribute__((packed)) meta;
+
+	meta.itm.beats.u = 0;
+	meta.itm.size = htobe32(sizeof(header_t) | ITEM_FLAG_META);
+	memcpy(meta.header.magic, magic, MAGIC_SIZE);
+	meta.header.version = htobe32(FORMAT_VERSION);
+	meta.header.rate = htobe32(rate);
+	_double_to_be(&meta.header.bpm, bpm);
+
+	return _writer_member(writer, &meta, sizeof(meta));
+}
+
+static int
+_writer_flush(writer_t *writer)
+{
+	if(writer->blk.size == 0)
+		return 0;
+
+	if(writer->index.n >= writer->index.max)
+	{
+		const size_t max = writer->index.max ? writer->index.max * 2 : 1024;
+		entry_t *entries = realloc(writer->index.entries, max * sizeof(entry_t));
+		if(!entries)
+			return -1;
+
+		writer->index.entries = entries;
+		writer->index.max = max;
+	}
+
+	entry_t *entry = &writer->index.entries[writer->index.n++];
+	entry->beats = writer->blk.beats;
+	entry->offset = writer->offset;
+	entry->count = writer->blk.count;
+	entry->tracks = writer->blk.tracks;
+
+	if(_writer_member(writer, writer->blk.buf, writer->blk.size) != 0)
+		return -1;
+	entry->size = writer->offset - entry->offset;
+
+	writer->blk.size = 0;
+	writer->blk.count = 0;
+	writer->blk.tracks = 0;
+
+	return 0;
+}
+
+// reserve item in current block, returns destination of its body
+static uint8_t *
+_writer_reserve(writer_t *writer, double beats, uint32_t size)
+{
+	if(writer->blk.size == 0)
+		writer->blk.beats = beats;
+
+	item_t itm = {
+		.beats.d = beats,
+		.size = size
+	};
+	itm.beats.u = htobe64(itm.beats.u);
+	itm.size = htobe32(itm.size);
+
+	uint8_t *dst = &writer->blk.buf[writer->blk.size];
+	memcpy(dst, &itm, sizeof(item_t));
+	writer->blk.size += sizeof(item_t) + ITEM_SIZE(size);
+
+	if(ITEM_IS_EVENT(size))
+	{
+		writer->blk.count += 1;
+		writer->blk.tracks |= 1U << ITEM_TRACK(size);
+		writer->events += 1;
+		writer->last = fmax(writer->last, beats);
+	}
+
+	return dst + sizeof(item_t);
+}
+
+static void
+_writer_append(writer_t *writer, double beats, uint32_t size, const void *body)
+{
+	memcpy(_writer_reserve(writer, beats, size), body, ITEM_SIZE(size));
+}
+
+// serialize pending shared dictionary entries, prefixed by their base index
+static int
+_writer_dict(writer_t *writer, size_t *size)
+{
+	uint32_t base;
+	size_t dict_size;
+	if(!netatom_shared_pending(writer->netatom, writer->dict + sizeof(uint32_t),
+		MAX_DICT - sizeof(uint32_t), &base, &dict_size))
+	{
+		return -1;
+	}
+
+	base = htobe32(base);
+	memcpy(writer->dict, &base, sizeof(uint32_t));
+	*size = dict_size ? sizeof(uint32_t) + dict_size : 0;
+
+	return 0;
+}
+
+// same framing as the plugin, newly referenced URIs precede the item in the
+// same block
+static int
+_writer_event(writer_t *writer, double beats, uint32_t track, const LV2_Atom *atom)
+{
+	// only register referenced URIs on this pass
+	size_t tx_size;
+	if(netatom_serialize_shared_sink(writer->netatom, atom, NULL, NULL, &tx_size) != 0)
+		return -1;
+
+	size_t dict_size;
+	if(_writer_dict(writer, &dict_size) != 0)
+		return -1;
+
+	const size_t tot_size = sizeof(item_t) + tx_size
+		+ (dict_size ? sizeof(item_t) + dict_size : 0);
+	if(tot_size > BLOCK_SIZE)
+		return -1;
+
+	if( (writer->blk.size + tot_size > BLOCK_SIZE) && (_writer_flush(writer) != 0) )
+		return -1;
+
+	if(dict_size)
+		_writer_append(writer, beats, dict_size | ITEM_FLAG_DICT, writer->dict);
+
+	uint8_t *dst = _writer_reserve(writer, beats,
+		tx_size | ITEM_FLAG_SHARED | ITEM_FLAG_TRACK(track));
+	netatom_serialize_shared_into(writer->netatom, atom, dst, tx_size, NULL);
+
+	return 0;
+}
+
+static int
+_writer_close(writer_t *writer)
+{
+	int res = _writer_flush(writer);
+
+	// index with complete dictionary, same layout as written by plugin
+	size_t dict_size = 0;
+	netatom_shared_rewind(writer->netatom);
+	if( (res == 0) && (_writer_dict(writer, &dict_size) != 0) )
+		res = -1;
+
+	const size_t tot_size = sizeof(item_t) + sizeof(uint32_t)
+		+ writer->index.n * sizeof(entry_t) + sizeof(uint32_t) + dict_size;
+	uint8_t *buf = (res == 0) ? malloc(tot_size) : NULL;
+	if(buf)
+	{
+		item_t *itm = (item_t *)buf;
+		itm->beats.u = 0;
+		itm->size = 0;
+
+		uint32_t *n = (uint32_t *)&itm[1];
+		*n = htobe32(writer->index.n);
+
+		entry_t *entries = (entry_t *)&n[1];
+		for(size_t i = 0; i < writer->index.n; i++)
+		{
+			const entry_t *src = &writer->index.entries[i];
+			entry_t *dst = &entries[i];
+
+			_double_to_be(&dst->beats, src->beats);
+			dst->offset = htobe64(src->offset);
+			dst->count = htobe32(src->count);
+			dst->tracks = htobe32(src->tracks);
+			dst->size = htobe32(src->size);
+		}
+
+		uint32_t *dict_n = (uint32_t *)&entries[writer->index.n];
+		*dict_n = htobe32(dict_size);
+		memcpy(&dict_n[1], writer->dict, dict_size);
+
+		const uint64_t index = writer->offset;
+		res = _writer_member(writer, buf, tot_size);
+		free(buf);
+
+		footer_t footer;
+		memcpy(footer.magic, magic, MAGIC_SIZE);
+		footer.version = htobe32(FORMAT_VERSION);
+		footer.events = htobe64(writer->events);
+		_double_to_be(&footer.first, writer->index.n ? writer->index.entries[0].beats : 0.0);
+		_double_to_be(&footer.last, writer->events ? writer->last : 0.0);
+		footer.index = htobe64(index);
+
+		if(res != 0)
+			; // already failed
+		else if(writer->raw)
+			res = _writer_member(writer, &footer, sizeof(footer_t));
+		else
+		{
+			uint8_t head [GZIP_HEADER_SIZE];
+			uint8_t tail [GZIP_TRAILER_SIZE];
+			_stored_wrap(&footer, sizeof(footer_t), head, tail);
+
+			if(  (write(writer->fd, head, sizeof(head)) != sizeof(head))
+				|| (write(writer->fd, &footer, sizeof(footer)) != sizeof(footer))
+				|| (write(writer->fd, tail, sizeof(tail)) != sizeof(tail)) )
+			{
+				res = -1;
+			}
+		}
+	}
+	else
+	{
+		res = -1;
+	}
+
+	if(!writer->raw)
+		deflateEnd(&writer->strm);
+	if(writer->netatom)
+		netatom_free(writer->netatom);
+	free(writer->index.entries);
+
+	if(close(writer->fd) != 0)
+		res = -1;
+
+	return res;
+}
+
+static int
+_list(store_t *store, const char *path)
+{
+	reader_t reader;
+	if(_reader_open(&reader, store, path) != 0)
+	{
+		_reader_close(&reader);
+		return -1;
+	}
+
+	uint32_t size;
+	int res;
+	while((res = _reader_next(&reader, &size)) == 0)
+	{
+		if(reader.flags & ITEM_FLAG_DICT)
+		{
+			printf("%14.6lf dict  %6"PRIu32"\n", reader.beats, size);
+			continue;
+		}
+		else if(reader.flags & ITEM_FLAG_META)
+		{
+			printf("%14.6lf meta  %6"PRIu32"\n", reader.beats, size);
+			continue;
+		}
+
+		const LV2_Atom *atom = _reader_atom(&reader, size);
+		if(!atom)
+		{
+			fprintf(stderr, "invalid event at %lf\n", reader.beats);
+			res = -1;
+			break;
+		}
+
+		const char *type = _unmap(store, atom->type);
+		printf("%14.6lf event %6"PRIu32" %2"PRIu32" %s", reader.beats, size,
+			ITEM_TRACK(reader.flags), type ? type : "(null)");
+
+		if(atom->type == store->midi_event)
+		{
+			const uint8_t *m = LV2_ATOM_BODY_CONST(atom);
+			for(uint32_t i = 0; i < atom->size; i++)
+				printf(" %02"PRIx8, m[i]);
+		}
+
+		printf("\n");
+	}
+
+	_reader_close(&reader);
+
+	return (res < 0) ? -1 : 0;
+}
+
+static int
+_stats(store_t *store, const char *path)
+{
+	reader_t reader;
+	if(_reader_open(&reader, store, path) != 0)
+	{
+		_reader_close(&reader);
+		return -1;
+	}
+
+	uint32_t size;
+	if(_reader_next(&reader, &size) < 0) // header, if any, is first item
+	{
+		_reader_close(&reader);
+		return -1;
+	}
+
+	if(reader.has_header)
+	{
+		printf("version: %"PRIu32"\n", be32toh(reader.header.version));
+		printf("rate:    %"PRIu32"\n", be32toh(reader.header.rate));
+		printf("bpm:     %lf\n", _double_from_be(&reader.header.bpm));
+	}
+	else
+	{
+		printf("version: legacy\n");
+	}
+
+	uint64_t events = 0;
+	double first = 0.0;
+	double last = 0.0;
+
+	if(reader.has_footer)
+	{
+		events = be64toh(reader.footer.events);
+		first = _double_from_be(&reader.footer.first);
+		last = _double_from_be(&reader.footer.last);
+	}
+	else // not closed properly, count by hand
+	{
+		int res = 0;
+		first = INFINITY;
+		last = -INFINITY;
+
+		do
+		{
+			if(ITEM_IS_EVENT(reader.flags))
+			{
+				events += 1;
+				first = fmin(first, reader.beats);
+				last = fmax(last, reader.beats);
+			}
+		} while((res = _reader_next(&reader, &size)) == 0);
+
+		if(!events)
+			first = last = 0.0;
+	}
+
+	printf("indexed: %s\n", reader.has_footer ? "yes" : "no");
+	printf("events:  %"PRIu64"\n", events);
+	printf("first:   %lf\n", first);
+	printf("last:    %lf\n", last);
+
+	_reader_close(&reader);
+
+	return 0;
+}
+
+static int
+_varlen_write(FILE *f, uint32_t val)
+{
+	uint8_t buf [5];
+	unsigned n = 0;
+
+	buf[n++] = val & 0x7f;
+	while( (val >>= 7) )
+		buf[n++] = 0x80 | (val & 0x7f);
+
+	while(n--)
+	{
+		if(fputc(buf[n], f) == EOF)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int
+_be_write(FILE *f, uint32_t val, unsigned n)
+{
+	while(n--)
+	{
+		if(fputc( (val >> (n * 8)) & 0xff, f) == EOF)
+			return -1;
+	}
+
+	return 0;
+}
+
+// MIDI events to Standard MIDI File of format 0, other atoms are skipped
+static int
+_export(store_t *store, const char *src, const char *dst)
+{
+	reader_t reader;
+	if(_reader_open(&reader, store, src) != 0)
+	{
+		_reader_close(&reader);
+		return -1;
+	}
+
+	FILE *f = fopen(dst, "wb");
+	if(!f)
+	{
+		fprintf(stderr, "failed to open '%s': %s\n", dst, strerror(errno));
+		_reader_close(&reader);
+		return -1;
+	}
+
+	uint64_t skipped = 0;
+	uint64_t tick = 0;
+	uint32_t size;
+	int res;
+
+	// track length is patched in when done
+	fwrite("MThd", 4, 1, f);
+	_be_write(f, 6, 4);
+	_be_write(f, 0, 2); // format
+	_be_write(f, 1, 2); // tracks
+	_be_write(f, PPQN, 2);
+	fwrite("MTrk", 4, 1, f);
+	_be_write(f, 0, 4);
+	const long start = ftell(f);
+
+	bool tempo = false;
+	while((res = _reader_next(&reader, &size)) == 0)
+	{
+		if(!tempo && reader.has_header) // header is first item, if any
+		{
+			const double bpm = _double_from_be(&reader.header.bpm);
+			const uint32_t us = (bpm > 0.0) ? 60000000.0 / bpm : 500000;
+
+			_varlen_write(f, 0);
+			fwrite("\xff\x51\x03", 3, 1, f);
+			_be_write(f, us, 3);
+			tempo = true;
+		}
+
+		if(!ITEM_IS_EVENT(reader.flags))
+			continue;
+
+		const LV2_Atom *atom = _reader_atom(&reader, size);
+		if(!atom)
+		{
+			fprintf(stderr, "invalid event at %lf\n", reader.beats);
+			res = -1;
+			break;
+		}
+
+		const uint8_t *m = LV2_ATOM_BODY_CONST(atom);
+		if( (atom->type != store->midi_event) || (atom->size == 0) )
+		{
+			skipped += 1;
+			continue;
+		}
+
+		const double beats = fmax(reader.beats, 0.0);
+		const uint64_t abs = round(beats * PPQN);
+		const uint64_t delta = (abs > tick) ? abs - tick : 0;
+		tick += delta;
+
+		_varlen_write(f, delta);
+		if(m[0] == 0xf0) // sysex
+		{
+			fputc(0xf0, f);
+			_varlen_write(f, atom->size - 1);
+			fwrite(m + 1, atom->size - 1, 1, f);
+		}
+		else
+		{
+			fwrite(m, atom->size, 1, f);
+		}
+	}
+
+	_varlen_write(f, 0);
+	fwrite("\xff\x2f\x00", 3, 1, f); // end of track
+
+	const long end = ftell(f);
+	if(  (res < 0)
+		|| (fseek(f, start - 4, SEEK_SET) != 0)
+		|| (_be_write(f, end - start, 4) != 0)
+		|| ferror(f) )
+	{
+		res = -1;
+	}
+
+	if(fclose(f) != 0)
+		res = -1;
+
+	if(skipped)
+		fprintf(stderr, "skipped %"PRIu64" non-MIDI events\n", skipped);
+
+	_reader_close(&reader);
+
+	return (res < 0) ? -1 : 0;
+}
+
+static uint32_t
+_varlen_read(const uint8_t **cur, const uint8_t *end)
+{
+	uint32_t val = 0;
+
+	while(*cur < end)
+	{
+		const uint8_t byte = *(*cur)++;
+
+		val = (val << 7) | (byte & 0x7f);
+		if(!(byte & 0x80))
+			break;
+	}
+
+	return val;
+}
+
+static int
+_midi_cmp(const void *a, const void *b)
+{
+	const midi_t *ma = a;
+	const midi_t *mb = b;
+
+	if(ma->tick != mb->tick)
+		return (ma->tick < mb->tick) ? -1 : 1;
+
+	return (ma->order < mb->order) ? -1 : 1;
+}
+
+// channel and system exclusive messages of all tracks, meta events other than
+// tempo are dropped
+static int
+_midi_parse(const uint8_t *buf, size_t len, midi_t **midis, size_t *n,
+	uint16_t *division, double *bpm)
+{
+	const uint8_t *cur = buf;
+	const uint8_t *end = buf + len;
+	size_t max = 0;
+
+	if( (len < 14) || memcmp(cur, "MThd", 4) )
+		return -1;
+
+	const uint32_t hlen = ((uint32_t)cur[4] << 24) | (cur[5] << 16) | (cur[6] << 8) | cur[7];
+	const uint16_t ntracks = (cur[10] << 8) | cur[11];
+	*division = (cur[12] << 8) | cur[13];
+	if( (*division & 0x8000) || (*division == 0) )
+	{
+		fprintf(stderr, "SMPTE time division not supported\n");
+		return -1;
+	}
+	if( (hlen < 6) || (hlen > len - 8) )
+		return -1;
+	cur += 8 + hlen;
+
+	for(unsigned t = 0; (t < ntracks) && (cur + 8 <= end); t++)
+	{
+		const uint32_t tlen = ((uint32_t)cur[4] << 24) | (cur[5] << 16) | (cur[6] << 8) | cur[7];
+		const bool track = !memcmp(cur, "MTrk", 4);
+		cur += 8;
+
+		if(tlen > (size_t)(end - cur))
+			return -1;
+		const uint8_t *tend = cur + tlen;
+
+		uint64_t tick = 0;
+		uint8_t status = 0;
+
+		while(track && (cur < tend) )
+		{
+			tick += _varlen_read(&cur, tend);
+			if(cur >= tend)
+				return -1;
+
+			const uint8_t *data; // message without status byte
+			uint32_t size;
+
+			if(*cur == 0xff) // meta
+			{
+				if(tend - cur < 2)
+					return -1;
+
+				const uint8_t type = cur[1];
+				cur += 2;
+				const uint32_t mlen = _varlen_read(&cur, tend);
+				if(mlen > (size_t)(tend - cur))
+					return -1;
+
+				if( (type == 0x51) && (mlen == 3) && (*bpm == 0.0) )
+					*bpm = 60000000.0 / ( (cur[0] << 16) | (cur[1] << 8) | cur[2]);
+
+				cur = (type == 0x2f) ? tend : cur + mlen; // end of track
+
+				continue;
+			}
+			else if(*cur == 0xf0) // sysex
+			{
+				cur += 1;
+				size = _varlen_read(&cur, tend);
+				if(size > (size_t)(tend - cur))
+					return -1;
+
+				data = cur;
+				cur += size;
+				size += 1;
+				status = 0xf0; // running status is cancelled anyway
+			}
+			else if(*cur == 0xf7) // escaped data, e.g. sysex continuation
+			{
+				cur += 1;
+				const uint32_t slen = _varlen_read(&cur, tend);
+				if(slen > (size_t)(tend - cur))
+					return -1;
+
+				cur += slen;
+
+				continue;
+			}
+			else
+			{
+				if(*cur & 0x80)
+					status = *cur++;
+
+				if(!status || (status == 0xf0) )
+					return -1; // running status without status byte
+
+				const uint8_t cmd = status & 0xf0;
+				size = 1 + ( ( (cmd == 0xc0) || (cmd == 0xd0) ) ? 1 : 2);
+				if(size - 1 > (size_t)(tend - cur))
+					return -1;
+
+				data = cur;
+				cur += size - 1;
+			}
+
+			if(*n >= max)
+			{
+				max = max ? max * 2 : 4096;
+				midi_t *tmp = realloc(*midis, max * sizeof(midi_t));
+				if(!tmp)
+					return -1;
+				*midis = tmp;
+			}
+
+			midi_t *midi = &(*midis)[*n];
+			midi->tick = tick;
+			midi->order = *n;
+			midi->size = size;
+			midi->body = malloc(size);
+			if(!midi->body)
+				return -1;
+
+			midi->body[0] = status;
+			memcpy(midi->body + 1, data, size - 1);
+
+			*n += 1;
+		}
+
+		cur = tend;
+	}
+
+	qsort(*midis, *n, sizeof(midi_t), _midi_cmp);
+
+	return 0;
+}
+
+static int
+_import(store_t *store, const char *src, const char *dst,
+	compression_t compression, uint32_t rate)
+{
+	FILE *f = fopen(src, "rb");
+	if(!f)
+	{
+		fprintf(stderr, "failed to open '%s': %s\n", src, strerror(errno));
+		return -1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	const long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	uint8_t *buf = (len > 0) ? malloc(len) : NULL;
+	if(!buf || (fread(buf, len, 1, f) != 1) )
+	{
+		fprintf(stderr, "failed to read '%s'\n", src);
+		free(buf);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	midi_t *midis = NULL;
+	size_t n = 0;
+	uint16_t division = 0;
+	double bpm = 0.0;
+	int res = _midi_parse(buf, len, &midis, &n, &division, &bpm);
+	free(buf);
+
+	if(res != 0)
+		fprintf(stderr, "invalid MIDI file '%s'\n", src);
+
+	writer_t *writer = calloc(1, sizeof(writer_t));
+	if( (res == 0) && (!writer
+		|| (_writer_open(writer, store, dst, compression, rate, bpm ? bpm : 120.0) != 0) ) )
+	{
+		res = -1;
+	}
+
+	struct {
+		LV2_Atom atom;
+		uint8_t body [MAX_BUF];
+	} ev;
+
+	for(size_t i = 0; (res == 0) && (i < n); i++)
+	{
+		const midi_t *midi = &midis[i];
+
+		if(midi->size > sizeof(ev.body))
+			continue;
+
+		ev.atom.size = midi->size;
+		ev.atom.type = store->midi_event;
+		memcpy(ev.body, midi->body, midi->size);
+
+		if(_writer_event(writer, (double)midi->tick / division, 0, &ev.atom) != 0)
+		{
+			fprintf(stderr, "failed to write event %zu\n", i);
+			res = -1;
+		}
+	}
+
+	if(writer && (writer->fd > 0) && (_writer_close(writer) != 0) )
+		res = -1;
+	free(writer);
+
+	for(size_t i = 0; i < n; i++)
+		free(midis[i].body);
+	free(midis);
+
+	return res;
+}
+
+// decode and re-encode every event, e.g. at different compression level
+static int
+_convert(store_t *store, const char *src, const char *dst,
+	compression_t compression)
+{
+	reader_t reader;
+	if(_reader_open(&reader, store, src) != 0)
+	{
+		_reader_close(&reader);
+		return -1;
+	}
+
+	uint32_t size;
+	int res = _reader_next(&reader, &size); // header, if any, is first item
+
+	writer_t *writer = calloc(1, sizeof(writer_t));
+	if( (res >= 0) && (!writer
+		|| (_writer_open(writer, store, dst, compression,
+			reader.has_header ? be32toh(reader.header.rate) : 0,
+			reader.has_header ? _double_from_be(&reader.header.bpm) : 0.0) != 0) ) )
+	{
+		res = -1;
+	}
+
+	for( ; res == 0; res = _reader_next(&reader, &size))
+	{
+		if(!ITEM_IS_EVENT(reader.flags))
+			continue;
+
+		const LV2_Atom *atom = _reader_atom(&reader, size);
+		if(!atom || (_writer_event(writer, reader.beats, ITEM_TRACK(reader.flags), atom) != 0) )
+		{
+			fprintf(stderr, "failed to convert event at %lf\n", reader.beats);
+			res = -1;
+		}
+	}
+
+	if(writer && (writer->fd > 0) && (_writer_close(writer) != 0) )
+		res = -1;
+	free(writer);
+
+	_reader_close(&reader);
+
+	return (res < 0) ? -1 : 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	compression_t compression = TC_COMPRESSION_BEST;
+	uint32_t rate = 0;
+
+	int c;
+	while((c = getopt(argc, argv, "c:r:h")) != -1)
+	{
+		switch(c)
+		{
+			case 'c':
+			{
+				const int level = atoi(optarg);
+				if( (level < TC_COMPRESSION_NONE) || (level >= TC_COMPRESSION_MAX) )
+				{
+					fprintf(stderr, "%s", usage);
+					return 1;
+				}
+				compression = level;
+			} break;
+			case 'r':
+			{
+				rate = strtoul(optarg, NULL, 10);
+			} break;
+			default:
+			{
+				fprintf(stderr, "%s", usage);
+				return (c == 'h') ? 0 : 1;
+			}
+		}
+	}
+
+	const int nargs = argc - optind;
+	const char *cmd = (nargs > 0) ? argv[optind] : "";
+	const char *src = (nargs > 1) ? argv[optind + 1] : NULL;
+	const char *dst = (nargs > 2) ? argv[optind + 2] : NULL;
+
+	store_t *store = calloc(1, sizeof(store_t));
+	if(!store)
+		return 1;
+	_store_init(store);
+
+	int res;
+	if(!strcmp(cmd, "list") && src)
+		res = _list(store, src);
+	else if(!strcmp(cmd, "stats") && src)
+		res = _stats(store, src);
+	else if(!strcmp(cmd, "export") && src && dst)
+		res = _export(store, src, dst);
+	else if(!strcmp(cmd, "import") && src && dst)
+		res = _import(store, src, dst, compression, rate);
+	else if(!strcmp(cmd, "convert") && src && dst)
+		res = _convert(store, src, dst, compression);
+	else
+	{
+		fprintf(stderr, "%s", usage);
+		res = -1;
+	}
+
+	_store_deinit(store);
+	free(store);
+
+	return (res == 0) ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2015-2016 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _ORBIT_CAPSULE_H
+#define _ORBIT_CAPSULE_H
+
+// on-disk format of timecapsule recordings, shared by plugin and tool
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <netatom.lv2/endian.h>
+
+#define MAGIC_SIZE 8
+#define FORMAT_VERSION 3 // tracks since version 2, block sizes since version 3
+#define BLOCK_SIZE 0x10000 // 64K uncompressed per seekable block
+#define GZIP_HEADER_SIZE 15 // header + stored block header
+#define GZIP_TRAILER_SIZE 8 // crc32 + isize
+#define MAX_DICT (BLOCK_SIZE / 2)
+#define MAX_STORED 0xffff // max payload of a single stored deflate block
+
+#define ITEM_FLAG_DICT 0x80000000 // shared dictionary entries
+#define ITEM_FLAG_SHARED 0x40000000 // atom referencing shared dictionary
+#define ITEM_FLAG_META 0x20000000 // file header, not to be played back
+#define ITEM_TRACK_SHIFT 24
+#define ITEM_TRACK_MASK 0x1f000000 // track of event
+#define ITEM_FLAG_TRACK(track) (((uint32_t)(track) << ITEM_TRACK_SHIFT) & ITEM_TRACK_MASK)
+#define ITEM_TRACK(size) (((size) & ITEM_TRACK_MASK) >> ITEM_TRACK_SHIFT)
+#define ITEM_SIZE(size) ((size) & ~(ITEM_FLAG_DICT | ITEM_FLAG_SHARED | ITEM_FLAG_META | ITEM_TRACK_MASK))
+#define ITEM_IS_EVENT(size) !((size) & (ITEM_FLAG_DICT | ITEM_FLAG_META))
+#define MAX_TRACKS 32
+#define ENTRY_SIZE_V1 offsetof(entry_t, tracks) // without track mask
+#define ENTRY_SIZE_V2 offsetof(entry_t, size) // without block size
+
+#if !defined(O_BINARY)
+#	define O_BINARY 0
+#endif
+
+typedef struct _item_t item_t;
+typedef struct _entry_t entry_t;
+typedef struct _header_t header_t;
+typedef struct _footer_t footer_t;
+typedef struct _checkpoint_t checkpoint_t;
+typedef enum _compression_t compression_t;
+
+struct _item_t {
+	union {
+		uint64_t u;
+		double d;
+	} beats;
+	uint32_t size;
+} __attribute__((packed));
+
+// seek index entry, first item of block, its file offset, event count, mask
+// of tracks with events in it and its size in the file, blocks are listed in
+// order of beats, but need not be stored in that order
+struct _entry_t {
+	double beats;
+	uint64_t offset;
+	uint32_t count;
+	uint32_t tracks;
+	uint32_t size;
+} __attribute__((packed));
+
+// located at start of file as meta item, context of recording
+struct _header_t {
+	char magic [MAGIC_SIZE];
+	uint32_t version;
+	uint32_t rate;
+	double bpm;
+} __attribute__((packed));
+
+// located at fixed offset from end of file, summarizes recording and points
+// to seek index
+struct _footer_t {
+	char magic [MAGIC_SIZE];
+	uint32_t version;
+	uint64_t events;
+	double first;
+	double last;
+	uint64_t index;
+} __attribute__((packed));
+
+// periodically written as meta item in a stored gzip member (or raw) while
+// recording, followed by index entries and dictionary entries added since the
+// previous checkpoint, so an unfinalized recording can be recovered by
+// scanning backwards from the end of the file
+struct _checkpoint_t {
+	char magic [MAGIC_SIZE];
+	uint32_t version;
+	uint32_t crc; // of remainder of checkpoint, entries and dictionary
+	uint32_t size; // of entries and dictionary following
+	uint64_t prev; // offset of previous checkpoint member, 0 if first
+	uint64_t events;
+	double first;
+	double last;
+	uint32_t n; // index entries following
+	uint32_t base; // of dictionary entries following index entries
+} __attribute__((packed));
+
+enum _compression_t {
+	TC_COMPRESSION_NONE,
+	TC_COMPRESSION_FAST,
+	TC_COMPRESSION_DEFAULT,
+	TC_COMPRESSION_BEST,
+
+	TC_COMPRESSION_MAX
+};
+
+static const char magic [MAGIC_SIZE] = "netatom";
+static const char checkpoint_magic [MAGIC_SIZE] = "netachk";
+
+static const int writing_levels [TC_COMPRESSION_MAX] = {
+	[TC_COMPRESSION_NONE] = Z_NO_COMPRESSION,
+	[TC_COMPRESSION_FAST] = Z_BEST_SPEED,
+	[TC_COMPRESSION_DEFAULT] = Z_DEFAULT_COMPRESSION,
+	[TC_COMPRESSION_BEST] = Z_BEST_COMPRESSION
+};
+
+// store double in network byte order, e.g. into packed structure
+static inline void
+_double_to_be(void *dst, double d)
+{
+	union {
+		uint64_t u;
+		double d;
+	} val = {
+		.d = d
+	};
+
+	val.u = htobe64(val.u);
+	memcpy(dst, &val, sizeof(double));
+}
+
+static inline double
+_double_from_be(const void *src)
+{
+	union {
+		uint64_t u;
+		double d;
+	} val;
+
+	memcpy(&val, src, sizeof(double));
+	val.u = be64toh(val.u);
+
+	return val.d;
+}
+
+// wrap buffer into stored gzip member, so its payload can be found verbatim,
+// e.g. footer at fixed offset from end
+static inline void
+_stored_wrap(const void *buf, uint16_t len, uint8_t head [GZIP_HEADER_SIZE],
+	uint8_t tail [GZIP_TRAILER_SIZE])
+{
+	const uint32_t crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef *)buf, len);
+
+	const uint8_t _head [GZIP_HEADER_SIZE] = {
+		0x1f, 0x8b, Z_DEFLATED, 0x0, // magic, method, flags
+		0x0, 0x0, 0x0, 0x0, // mtime
+		0x0, 0xff, // xflags, os
+		0x1, len & 0xff, len >> 8, ~len & 0xff, (~len >> 8) & 0xff // final stored block
+	};
+	const uint8_t _tail [GZIP_TRAILER_SIZE] = {
+		crc & 0xff, (crc >> 8) & 0xff, (crc >> 16) & 0xff, crc >> 24,
+		len & 0xff, len >> 8, 0x0, 0x0
+	};
+
+	memcpy(head, _head, GZIP_HEADER_SIZE);
+	memcpy(tail, _tail, GZIP_TRAILER_SIZE);
+}
+
+// crc of checkpoint behind its crc field, including entries and dictionary
+static inline uint32_t
+_checkpoint_crc(const checkpoint_t *chk, uint32_t size)
+{
+	const size_t skip = offsetof(checkpoint_t, size);
+
+	return crc32(crc32(0L, Z_NULL, 0), (const Bytef *)chk + skip,
+		sizeof(checkpoint_t) - skip + size);
+}
+
+// size of index entry as stored by given format version
+static inline size_t
+_entry_size(uint32_t version)
+{
+	if(version < 2)
+		return ENTRY_SIZE_V1;
+	else if(version < 3)
+		return ENTRY_SIZE_V2;
+
+	return sizeof(entry_t);
+}
+
+// block does not lie right behind its predecessor in the index, e.g. as it
+// has been recorded while punched in, readers need to seek to it
+static inline bool
+_entry_detached(const entry_t *entries, size_t i)
+{
+	return (i > 0) && (entries[i].offset != entries[i - 1].offset + entries[i - 1].size);
+}
+
+// look for footer in last bytes of file, either raw or wrapped in a stored
+// gzip member
+static inline int
+_footer_find(const uint8_t tail [sizeof(footer_t) + GZIP_TRAILER_SIZE],
+	footer_t *footer)
+{
+	if(!memcmp(tail, magic, MAGIC_SIZE))
+		memcpy(footer, tail, sizeof(footer_t));
+	else if(!memcmp(tail + GZIP_TRAILER_SIZE, magic, MAGIC_SIZE))
+		memcpy(footer, tail + GZIP_TRAILER_SIZE, sizeof(footer_t));
+	else
+		return -1; // not properly closed
+
+	return 0;
+}
+
+#endif // _ORBIT_CAPSULE_H
@@ -24,12 +24,14 @@
 #include <timely.h>
 #include <props.h>
 
-#define MAX_NPROPS 10
+#define MAX_NPROPS 13
 
-#define BUF_SIZE 0x2000000 // 32 MB
-#define BUF_PERCENT (100.f / (BUF_SIZE - sizeof(LV2_Atom)))
+#define MAX_SLOTS 8
+#define BANK_SIZE 0x2000000 // 32 MB, shared among slots
+#define ARENA_SIZE (2 * BANK_SIZE) // 64 MB
 
 typedef enum _punchmode_t punchmode_t;
+typedef struct _slot_t slot_t;
 typedef struct _plugstate_t plugstate_t;
 typedef struct _plughandle_t plughandle_t;
 
@@ -38,6 +40,17 @@ enum _punchmode_t {
 	PUNCH_BAR					= 1
 };
 
+struct _slot_t {
+	unsigned play;
+	uint8_t *buf [2];
+
+	LV2_Atom_Event *play_ev_next;
+	LV2_Atom_Event *play_ev_prev;
+
+	LV2_Atom_Event *rec_ev_next;
+	LV2_Atom_Event *rec_ev_prev;
+};
+
 struct _plugstate_t {
 	int32_t punch;
 	int32_t width;
@@ -45,11 +58,14 @@ struct _plugstate_t {
 	int32_t switsch;
 	int32_t mute_toggle;
 	int32_t switsch_toggle;
+	int32_t slot;
+	int32_t slots;
+	int32_t program_channel;
 
 	int32_t play_capacity;
 	int32_t rec_capacity;
 	int32_t position;
-	uint8_t play_sequence [BUF_SIZE];
+	uint8_t bank [BANK_SIZE];
 };
 
 struct _plughandle_t {
@@ -67,8 +83,11 @@ struct _plughandle_t {
 		LV2_URID switsch_toggle;
 		LV2_URID play_capacity;
 		LV2_URID rec_capacity;
+		LV2_URID slot;
+		LV2_URID slots;
 		LV2_URID position;
 		LV2_URID beat_time;
+		LV2_URID bank;
 		LV2_URID play_sequence;
 		LV2_URID midi_event;
 	} urid;
@@ -87,16 +106,15 @@ struct _plughandle_t {
 
 	PROPS_T(props, MAX_NPROPS);
 
-	unsigned play;
 	bool rolling;
 	bool mute;
-	uint8_t buf [2][BUF_SIZE];
 
-	LV2_Atom_Event *play_ev_next;
-	LV2_Atom_Event *play_ev_prev;
-
-	LV2_Atom_Event *rec_ev_next;
-	LV2_Atom_Event *rec_ev_prev;
+	slot_t *slot;
+	unsigned nslots;
+	uint32_t slot_size;
+	float percent;
+	slot_t slots [MAX_SLOTS];
+	uint8_t arena [ARENA_SIZE];
 
 	bool active [0x10][0x80];
 };
@@ -148,17 +166,124 @@ _intercept_toggle(void *data, int64_t frames, props_impl_t *impl)
 	}
 }
 
+static inline void
+_seq_clear(plughandle_t *handle, uint8_t *buf)
+{
+	LV2_Atom_Sequence *seq = (LV2_Atom_Sequence *)buf;
+
+	seq->atom.type = handle->forge.Sequence;
+	seq->atom.size = sizeof(LV2_Atom_Sequence_Body);
+	seq->body.unit = handle->urid.beat_time;
+	seq->body.pad = 0;
+}
+
+static inline void
+_bank_load(plughandle_t *handle)
+{
+	props_impl_t *impl = _props_impl_get(&handle->props, handle->urid.bank);
+	if(!impl)
+		return;
+
+	// deserialize playback sequences of slots from tuple in state
+	unsigned i = 0;
+	LV2_ATOM_TUPLE_BODY_FOREACH(handle->state.bank, impl->value.size, item)
+	{
+		if(i >= handle->nslots)
+			break;
+
+		slot_t *slot = &handle->slots[i++];
+		LV2_Atom *atom = (LV2_Atom *)slot->buf[slot->play];
+
+		if(item->type != handle->forge.Sequence)
+			continue;
+
+		if(lv2_atom_total_size(item) <= handle->slot_size)
+		{
+			memcpy(atom, item, lv2_atom_total_size(item));
+		}
+		else if(handle->log)
+		{
+			lv2_log_error(&handle->logger, "sequence of slot %u exceeds slot capacity", i - 1);
+		}
+	}
+
+	// reposition on next punch boundary
+	for(i = 0; i < handle->nslots; i++)
+	{
+		slot_t *slot = &handle->slots[i];
+
+		slot->play_ev_next = NULL;
+		slot->play_ev_prev = NULL;
+	}
+}
+
+static inline void
+_bank_carve(plughandle_t *handle)
+{
+	handle->nslots = handle->state.slots;
+	handle->slot_size = (BANK_SIZE / handle->nslots) & ~7U; // keep atoms aligned
+	handle->percent = 100.f / (handle->slot_size - sizeof(LV2_Atom));
+
+	// carve playback and recording buffers of active slots from arena
+	for(unsigned i = 0; i < handle->nslots; i++)
+	{
+		slot_t *slot = &handle->slots[i];
+
+		slot->play = 0;
+		slot->buf[0] = &handle->arena[(2*i + 0) * handle->slot_size];
+		slot->buf[1] = &handle->arena[(2*i + 1) * handle->slot_size];
+
+		_seq_clear(handle, slot->buf[0]);
+		_seq_clear(handle, slot->buf[1]);
+
+		slot->play_ev_next = NULL;
+		slot->play_ev_prev = NULL;
+		slot->rec_ev_next = NULL;
+		slot->rec_ev_prev = NULL;
+	}
+
+	if(handle->state.slot >= (int32_t)handle->nslots)
+		handle->state.slot = handle->nslots - 1;
+	handle->slot = &handle->slots[handle->state.slot];
+}
+
 static void
-_intercept_play(void *data, int64_t frames, props_impl_t *impl)
+_intercept_slot(void *data, int64_t frames, props_impl_t *impl)
 {
 	plughandle_t *handle = data;
 
-	LV2_Atom *atom = (LV2_Atom *)handle->buf[handle->play];
-	uint8_t *body = LV2_ATOM_BODY(atom);
+	if(handle->state.slot < 0)
+		handle->state.slot = 0;
+	else if(handle->state.slot >= (int32_t)handle->nslots)
+		handle->state.slot = handle->nslots - 1;
+}
+
+static void
+_intercept_slots(void *data, int64_t frames, props_impl_t *impl)
+{
+	plughandle_t *handle = data;
+
+	if(handle->state.slots < 1)
+		handle->state.slots = 1;
+	else if(handle->state.slots > MAX_SLOTS)
+		handle->state.slots = MAX_SLOTS;
+
+	if(handle->nslots == (unsigned)handle->state.slots)
+		return;
+
+	// reslice arena, stored playback sequences are reloaded, recordings are lost
+	_bank_carve(handle);
+	_bank_load(handle);
+
+	props_set(&handle->props, &handle->forge, frames, handle->urid.slot, &handle->ref);
+}
+
+static void
+_intercept_bank(void *data, int64_t frames, props_impl_t *impl)
+{
+	plughandle_t *handle = data;
 
-	atom->size = impl->value.size;
-	atom->type = impl->type;
-	memcpy(body, handle->state.play_sequence, impl->value.size);
+	_bank_load(handle);
 }
 
 static const props_def_t defs [MAX_NPROPS] = {
@@ -196,6 +321,23 @@ static const props_def_t defs [MAX_NPROPS] = {
 		.type = LV2_ATOM__Bool,
 		.event_cb = _intercept_toggle
 	},
+	{
+		.property = ORBIT_URI"#looper_slot",
+		.offset = offsetof(plugstate_t, slot),
+		.type = LV2_ATOM__Int,
+		.event_cb = _intercept_slot
+	},
+	{
+		.property = ORBIT_URI"#looper_slots",
+		.offset = offsetof(plugstate_t, slots),
+		.type = LV2_ATOM__Int,
+		.event_cb = _intercept_slots
+	},
+	{
+		.property = ORBIT_URI"#looper_program_channel",
+		.offset = offsetof(plugstate_t, program_channel),
+		.type = LV2_ATOM__Int,
+	},
 	{
 		.property = ORBIT_URI"#looper_play_capacity",
 		.offset = offsetof(plugstate_t, play_capacity),
@@ -215,13 +357,13 @@ static const props_def_t defs [MAX_NPROPS] = {
 		.type = LV2_ATOM__Int,
 	},
 	{
-		.property = ORBIT_URI"#looper_play_sequence",
-		.offset = offsetof(plugstate_t, play_sequence),
+		.property = ORBIT_URI"#looper_bank",
+		.offset = offsetof(plugstate_t, bank),
 		.access = LV2_PATCH__writable,
-		.type = LV2_ATOM__Sequence,
-		.max_size = BUF_SIZE,
+		.type = LV2_ATOM__Tuple,
+		.max_size = BANK_SIZE,
 		.hidden = true,
-		.event_cb = _intercept_play
+		.event_cb = _intercept_bank
 	},
 };
 
@@ -233,13 +375,14 @@ static const props_def_t defs [MAX_NPROPS] = {
 static inline void
 _play(plughandle_t *handle, int64_t to, uint32_t capacity)
 {
-	const LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)handle->buf[handle->play];
+	slot_t *slot = handle->slot;
+	const LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)slot->buf[slot->play];
 
 	const int64_t rel = handle->offset - to; // beginning of current period
 
-	if(handle->play_ev_next)
+	if(slot->play_ev_next)
 	{
-		LV2_ATOM_SEQUENCE_FOREACH_FROM(play_seq, handle->play_ev_next, ev)
+		LV2_ATOM_SEQUENCE_FOREACH_FROM(play_seq, slot->play_ev_next, ev)
 		{
 			const int64_t beat_frames = ev->time.beats * TIMELY_FRAMES_PER_BEAT(&handle->timely);
 
@@ -288,8 +431,8 @@ _play(plughandle_t *handle, int64_t to, uint32_t capacity)
 				handle->last = frames; // advance frame time head
 			}
 
-			handle->play_ev_prev = ev;
-			handle->play_ev_next = lv2_atom_sequence_next(ev);
+			slot->play_ev_prev = ev;
+			slot->play_ev_next = lv2_atom_sequence_next(ev);
 		}
 	}
 }
@@ -297,15 +440,16 @@ _play(plughandle_t *handle, int64_t to, uint32_t capacity)
 static inline void
 _rec(plughandle_t *handle, const LV2_Atom_Event *ev)
 {
-	LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)handle->buf[!handle->play];
+	slot_t *slot = handle->slot;
+	LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)slot->buf[!slot->play];
 
-	LV2_Atom_Event *e = lv2_atom_sequence_append_event(rec_seq, BUF_SIZE, ev);
+	LV2_Atom_Event *e = lv2_atom_sequence_append_event(rec_seq, handle->slot_size, ev);
 	if(e)
 	{
 		e->time.beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
 
-		handle->rec_ev_prev = handle->rec_ev_next;
-		handle->rec_ev_next = e;
+		slot->rec_ev_prev = slot->rec_ev_next;
+		slot->rec_ev_next = e;
 	}
 	else if(handle->log)
 	{
@@ -316,16 +460,17 @@ _rec(plughandle_t *handle, const LV2_Atom_Event *ev)
 static inline void
 _reposition_play(plughandle_t *handle)
 {
-	LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)handle->buf[handle->play];
+	slot_t *slot = handle->slot;
+	LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)slot->buf[slot->play];
 	LV2_Atom_Event *from = lv2_atom_sequence_begin(&play_seq->body);
 
-	if(handle->play_ev_prev && handle->play_ev_next)
+	if(slot->play_ev_prev && slot->play_ev_next)
 	{
-		const int64_t beat_frames = handle->play_ev_prev->time.beats * TIMELY_FRAMES_PER_BEAT(&handle->timely);
+		const int64_t beat_frames = slot->play_ev_prev->time.beats * TIMELY_FRAMES_PER_BEAT(&handle->timely);
 
 		if(beat_frames < handle->offset)
 		{
-			from = handle->play_ev_prev; // search from here, not beginning
+			from = slot->play_ev_prev; // search from here, not beginning
 		}
 		else
 		{
@@ -340,31 +485,32 @@ _reposition_play(plughandle_t *handle)
 		if(beat_frames >= handle->offset)
 		{
 			// reposition here
-			handle->play_ev_prev = handle->play_ev_next;
-			handle->play_ev_next = ev;
+			slot->play_ev_prev = slot->play_ev_next;
+			slot->play_ev_next = ev;
 
 			return;
 		}
 	}
 
 	//printf("play null\n");
-	handle->play_ev_prev = NULL;
-	handle->play_ev_next = NULL;
+	slot->play_ev_prev = NULL;
+	slot->play_ev_next = NULL;
 }
 
 static inline void
 _reposition_rec(plughandle_t *handle)
 {
-	LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)handle->buf[!handle->play];
+	slot_t *slot = handle->slot;
+	LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)slot->buf[!slot->play];
 	LV2_Atom_Event *from = lv2_atom_sequence_begin(&rec_seq->body);
 
-	if(handle->rec_ev_prev && handle->rec_ev_next)
+	if(slot->rec_ev_prev && slot->rec_ev_next)
 	{
-		const int64_t beat_frames = handle->rec_ev_prev->time.beats * TIMELY_FRAMES_PER_BEAT(&handle->timely);
+		const int64_t beat_frames = slot->rec_ev_prev->time.beats * TIMELY_FRAMES_PER_BEAT(&handle->timely);
 
 		if(beat_frames < handle->offset)
 		{
-			from = handle->rec_ev_prev; // search from here, not beginning
+			from = slot->rec_ev_prev; // search from here, not beginning
 		}
 		else
 		{
@@ -378,8 +524,8 @@ _reposition_rec(plughandle_t *handle)
 
 		if(beat_frames >= handle->offset)
 		{
-			handle->rec_ev_prev = handle->rec_ev_next; //FIXME check
-			handle->rec_ev_next = ev; //FIXME check
+			slot->rec_ev_prev = slot->rec_ev_next; //FIXME check
+			slot->rec_ev_next = ev; //FIXME check
 
 			// truncate sequence here
 			rec_seq->atom.size = (uintptr_t)ev - (uintptr_t)&rec_seq->body;
@@ -389,8 +535,54 @@ _reposition_rec(plughandle_t *handle)
 	}
 
 	//printf("rec null\n");
-	handle->rec_ev_prev = NULL;
-	handle->rec_ev_next = NULL;
+	slot->rec_ev_prev = NULL;
+	slot->rec_ev_next = NULL;
+}
+
+static inline void
+_bank_store(plughandle_t *handle)
+{
+	props_impl_t *impl = _props_impl_get(&handle->props, handle->urid.bank);
+	if(!impl)
+		return;
+
+	// serialize playback sequences of all slots as tuple into state
+	uint8_t *dst = handle->state.bank;
+	for(unsigned i = 0; i < handle->nslots; i++)
+	{
+		const slot_t *slot = &handle->slots[i];
+		const LV2_Atom *play_seq = (const LV2_Atom *)slot->buf[slot->play];
+		const uint32_t tot_size = lv2_atom_total_size(play_seq);
+
+		memcpy(dst, play_seq, tot_size);
+		dst += lv2_atom_pad_size(tot_size);
+	}
+
+	impl->value.size = dst - handle->state.bank;
+	_props_impl_stash(&handle->props, impl);
+}
+
+static inline bool
+_program_change(plughandle_t *handle, int64_t frames, const LV2_Atom *atom)
+{
+	if( (atom->type != handle->urid.midi_event) || (atom->size != 2) )
+		return false;
+
+	// only consume program changes on our channel that select a slot
+	const uint8_t *msg = LV2_ATOM_BODY_CONST(atom);
+	if(  ( (msg[0] & 0xf0) != LV2_MIDI_MSG_PGM_CHANGE)
+		|| ( (msg[0] & 0x0f) != handle->state.program_channel)
+		|| (handle->nslots < 2)
+		|| (msg[1] >= handle->nslots) )
+	{
+		return false;
+	}
+
+	// select slot, switched at next punch boundary
+	handle->state.slot = msg[1];
+	props_set(&handle->props, &handle->forge, frames, handle->urid.slot, &handle->ref);
+
+	return true;
 }
 
 static void
@@ -421,19 +613,15 @@ _cb(timely_t *timely, int64_t frames, LV2_URID type, void *data)
 		{
 			if(handle->state.switsch)
 			{
-				handle->play = !handle->play;
+				handle->slot->play = !handle->slot->play;
 
 				// store new playback sequence in state
-				props_impl_t *impl = _props_impl_get(&handle->props, handle->urid.play_sequence);
-				if(impl)
-				{
-					const LV2_Atom *play_seq = (LV2_Atom *)handle->buf[handle->play];
-
-					_props_impl_set(&handle->props, impl, play_seq->type,
-						play_seq->size, LV2_ATOM_BODY_CONST(play_seq));
-				}
+				_bank_store(handle);
 			}
 
+			// switch to selected slot
+			handle->slot = &handle->slots[handle->state.slot];
+
 			// terminate hanging notes
 			for(uint8_t cha = 0x0; cha < 0x10; cha++)
 			{
@@ -468,8 +656,9 @@ _cb(timely_t *timely, int64_t frames, LV2_URID type, void *data)
 
 		if(beats == 0.0) // clear sequence buffers when transport is rewound
 		{
-			LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)handle->buf[handle->play];
-			LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)handle->buf[!handle->play];
+			slot_t *slot = handle->slot;
+			LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)slot->buf[slot->play];
+			LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)slot->buf[!slot->play];
 
 			//lv2_atom_sequence_clear(play_seq);
 			lv2_atom_sequence_clear(rec_seq);
@@ -545,10 +734,16 @@ instantiate(const LV2_Descriptor* descriptor, double rate,
 	handle->urid.mute_toggle = props_map(&handle->props, ORBIT_URI"#looper_mute_toggle");
 	handle->urid.switsch = props_map(&handle->props, ORBIT_URI"#looper_switch");
 	handle->urid.switsch_toggle = props_map(&handle->props, ORBIT_URI"#looper_switch_toggle");
+	handle->urid.slot = props_map(&handle->props, ORBIT_URI"#looper_slot");
 	handle->urid.play_capacity = props_map(&handle->props, ORBIT_URI"#looper_play_capacity");
 	handle->urid.rec_capacity = props_map(&handle->props, ORBIT_URI"#looper_rec_capacity");
 	handle->urid.position = props_map(&handle->props, ORBIT_URI"#looper_position");
-	handle->urid.play_sequence = props_map(&handle->props, ORBIT_URI"#looper_play_sequence");
+	handle->urid.slots = props_map(&handle->props, ORBIT_URI"#looper_slots");
+	handle->urid.bank = props_map(&handle->props, ORBIT_URI"#looper_bank");
+	handle->urid.play_sequence = handle->map->map(handle->map->handle, ORBIT_URI"#looper_play_sequence");
+
+	handle->state.slots = 1;
+	_bank_carve(handle);
 
 	return handle;
 }
@@ -577,22 +772,11 @@ activate(LV2_Handle instance)
 	plughandle_t *handle = instance;
 
 	handle->offset = 0.f;
-	handle->play = 0;
 	handle->mute = false;
 	handle->rolling = false;
 
-	LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)handle->buf[handle->play];
-	LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)handle->buf[!handle->play];
-
-	play_seq->atom.type = handle->forge.Sequence;
-	play_seq->atom.size = sizeof(LV2_Atom_Sequence_Body);
-	play_seq->body.unit = handle->urid.beat_time;
-	play_seq->body.pad = 0;
-
-	rec_seq->atom.type = handle->forge.Sequence;
-	rec_seq->atom.size = sizeof(LV2_Atom_Sequence_Body);
-	rec_seq->body.unit = handle->urid.beat_time;
-	rec_seq->body.pad = 0;
+	_bank_carve(handle);
+	_bank_load(handle);
 }
 
 static void
@@ -623,6 +807,10 @@ run(LV2_Handle instance, uint32_t nsamples)
 		{
 			handled = props_advance(&handle->props, &handle->forge, ev->time.frames, obj, &handle->ref);
 		}
+		if(!handled)
+		{
+			handled = _program_change(handle, ev->time.frames, &ev->body);
+		}
 
 		if(!handled && handle->rolling)
 		{
@@ -647,11 +835,12 @@ run(LV2_Handle instance, uint32_t nsamples)
 		_play(handle, nsamples, capacity);
 	}
 
-	LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)handle->buf[handle->play];
-	LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)handle->buf[!handle->play];
+	slot_t *slot = handle->slot;
+	LV2_Atom_Sequence *play_seq = (LV2_Atom_Sequence *)slot->buf[slot->play];
+	LV2_Atom_Sequence *rec_seq = (LV2_Atom_Sequence *)slot->buf[!slot->play];
 
-	const int32_t play_capacity = BUF_PERCENT * play_seq->atom.size;
-	const int32_t rec_capacity = BUF_PERCENT * rec_seq->atom.size;
+	const int32_t play_capacity = handle->percent * play_seq->atom.size;
+	const int32_t rec_capacity = handle->percent * rec_seq->atom.size;
 	const int32_t position = handle->offset * handle->window;
 
 	if(handle->ref && (play_capacity != handle->state.play_capacity) )
@@ -704,6 +893,65 @@ _state_save(LV2_Handle instance, LV2_State_Store_Function store,
 	return props_save(&handle->props, store, state, flags, features);
 }
 
+typedef struct _legacy_t legacy_t;
+
+struct _legacy_t {
+	plughandle_t *handle;
+	LV2_State_Retrieve_Function retrieve;
+	LV2_State_Handle state;
+	uint8_t *bank;
+};
+
+// map single playback sequence of sessions predating the bank to slot 0
+static const void *
+_legacy_retrieve(LV2_State_Handle state, uint32_t key, size_t *size,
+	uint32_t *type, uint32_t *flags)
+{
+	legacy_t *legacy = state;
+	plughandle_t *handle = legacy->handle;
+
+	const void *body = legacy->retrieve(legacy->state, key, size, type, flags);
+	if(body || ( (key != handle->urid.bank) && (key != handle->urid.slots) ) )
+		return body;
+
+	size_t seq_size;
+	uint32_t seq_type;
+	uint32_t seq_flags;
+	const void *seq_body = legacy->retrieve(legacy->state, handle->urid.play_sequence,
+		&seq_size, &seq_type, &seq_flags);
+	if(!seq_body || (seq_type != handle->forge.Sequence) )
+		return NULL;
+
+	if(key == handle->urid.slots) // keep whole capacity for single loop
+	{
+		static const int32_t slots = 1;
+
+		*size = sizeof(slots);
+		*type = handle->forge.Int;
+		*flags = seq_flags;
+		return &slots;
+	}
+
+	const size_t tot_size = lv2_atom_pad_size(sizeof(LV2_Atom) + seq_size);
+	if(tot_size > BANK_SIZE)
+		return NULL;
+
+	free(legacy->bank);
+	legacy->bank = calloc(1, tot_size);
+	if(!legacy->bank)
+		return NULL;
+
+	LV2_Atom *atom = (LV2_Atom *)legacy->bank;
+	atom->size = seq_size;
+	atom->type = seq_type;
+	memcpy(LV2_ATOM_BODY(atom), seq_body, seq_size);
+
+	*size = tot_size;
+	*type = handle->forge.Tuple;
+	*flags = seq_flags;
+	return legacy->bank;
+}
+
 static LV2_State_Status
 _state_restore(LV2_Handle instance, LV2_State_Retrieve_Function retrieve,
 	LV2_State_Handle state, uint32_t flags,
@@ -711,7 +959,19 @@ _state_restore(LV2_Handle instance, LV2_State_Retrieve_Function retrieve,
 {
 	plughandle_t *handle = instance;
 
-	return props_restore(&handle->props, retrieve, state, flags, features);
+	legacy_t legacy = {
+		.handle = handle,
+		.retrieve = retrieve,
+		.state = state,
+		.bank = NULL
+	};
+
+	const LV2_State_Status status = props_restore(&handle->props, _legacy_retrieve,
+		&legacy, flags, features);
+
+	free(legacy.bank);
+
+	return status;
 }
 
 static const LV2_State_Interface state_iface = {
@@ -22,6 +22,15 @@
 #include <limits.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#	include <semaphore.h>
+#	define USE_IO_THREAD // private i/o thread instead of host worker
+#endif
 
 #include <orbit.h>
 #include <timely.h>
@@ -29,25 +38,59 @@
 #include <varchunk.h>
 
 #define NETATOM_IMPLEMENTATION
+#define NETATOM_API static inline // only part of the API is used here
 #include <netatom.lv2/netatom.h>
 
-#define MAX_NPROPS 5
-#define MAGIC_SIZE 8
-#define MAX_BUF 8192
-
-typedef struct _item_t item_t;
+#include <orbit_capsule.h>
+
+#define MAX_NPROPS 29
+#define ZBUF_SIZE 0x4000
+#define MAX_CAPSULE 0x4000000 // 64M
+#define MAX_COMPRESSORS 4
+#define MAX_SLOTS (MAX_COMPRESSORS * 2)
+#define ZOUT_SIZE (BLOCK_SIZE + 0x100) // deflate bound of a block plus gzip wrapper
+#define READ_AHEAD_MS 500 // playback window streamed ahead of play head
+#define READ_TIMEOUT_MS (2 * READ_AHEAD_MS) // read-ahead response considered lost
+#define READ_BUDGET 0x40000 // max bytes queued per read-ahead
+#define MAX_CUES 8
+#define CUE_BEATS 4.0 // pre-roll captured after each jump
+#define CUE_EVENTS 0x400
+#define CUE_SIZE 0x8000
+#define RINGBUFFER_SIZE 0x100000 // 1M
+#define RESPONSES_SIZE 0x10000 // 64K
+#define GZ_BUFFER_SIZE 0x40000 // 256K, zlib defaults to 8K
+#define TELEMETRY_MS 1000 // minimal interval between telemetry updates
+
+typedef struct _stats_t stats_t;
+typedef struct _io_t io_t;
+typedef struct _report_t report_t;
 typedef enum _job_type_t job_type_t;
 typedef struct _job_t job_t;
+typedef struct _capsule_t capsule_t;
+typedef struct _event_t event_t;
+typedef struct _cue_t cue_t;
+typedef enum _slot_state_t slot_state_t;
+typedef struct _slot_t slot_t;
+typedef struct _pool_t pool_t;
 typedef struct _plugstate_t plugstate_t;
 typedef struct _plughandle_t plughandle_t;
 
-struct _item_t {
-	union {
-		uint64_t u;
-		double d;
-	} beats;
-	uint32_t size;
-} __attribute__((packed));
+struct _stats_t {
+	int64_t events;
+	double first;
+	double last;
+	int32_t rate;
+	float bpm;
+};
+
+// cumulative disk i/o of worker thread
+struct _io_t {
+	int64_t written; // to disk, including index and checkpoints
+	int64_t encoded; // item bytes handed over to compression
+	int64_t compressed; // of above, as written to disk
+	int64_t read; // bytes streamed back to rt-thread
+	int64_t overflows;
+};
 
 enum _job_type_t {
 	TC_JOB_DRAIN,
@@ -55,24 +98,139 @@ enum _job_type_t {
 	TC_JOB_READ,
 	TC_JOB_REPOSITION_REC,
 	TC_JOB_WRITE,
-	TC_JOB_CHANGE_PATH
+	TC_JOB_CHANGE_PATH,
+	TC_JOB_MAPPED,
+	TC_JOB_LOAD,
+	TC_JOB_FREE,
+	TC_JOB_STATS,
+	TC_JOB_CHECKPOINT,
+	TC_JOB_IO,
+	TC_JOB_PRELOAD
 };
 
 struct _job_t {
 	job_type_t type;
 	double beats;
+	double until; // end of preceding recording, if any
+	double bpm;
+	uint32_t seq;
+	int32_t compression;
+	uint32_t track; // of recorded event
+	uint32_t muted; // mask of tracks skipped on playback
+	struct {
+		double start;
+		double end;
+	} loop;
 	union {
 		LV2_Atom atom [0];
 		char file_path [0];
+		const LV2_Atom *ref; // into memory-mapped recording
+		capsule_t *capsule;
+	};
+};
+
+// worker response with statistics of opened recording or disk i/o
+struct _report_t {
+	job_type_t type;
+	union {
+		stats_t stats;
+		io_t io;
 	};
 };
 
+struct _event_t {
+	double beats;
+	size_t offset;
+	uint32_t track;
+};
+
+// whole recording loaded into memory
+struct _capsule_t {
+	size_t n;
+	size_t size;
+	event_t events [0]; // followed by atoms
+};
+
+// decoded pre-roll around a recent jump target, owned by rt-thread
+struct _cue_t {
+	bool valid;
+	double beats;
+	double until;
+	uint64_t used;
+	size_t n;
+	size_t size;
+	event_t events [CUE_EVENTS];
+	uint8_t body [CUE_SIZE];
+};
+
+enum _slot_state_t {
+	SLOT_FREE,
+	SLOT_PENDING,
+	SLOT_BUSY,
+	SLOT_DONE
+};
+
+// block in flight through the compression pool
+struct _slot_t {
+	slot_state_t state;
+	int level;
+	int status;
+	double beats;
+	uint32_t count;
+	uint32_t tracks;
+	size_t size;
+	size_t out_size;
+	uint8_t buf [BLOCK_SIZE];
+	uint8_t out [ZOUT_SIZE];
+};
+
+// private compression threads, blocks are deflated in parallel and written
+// out in order by the worker
+struct _pool_t {
+	pthread_mutex_t mutex;
+	pthread_cond_t pending;
+	pthread_cond_t done;
+	bool quit;
+	unsigned nthreads;
+	pthread_t threads [MAX_COMPRESSORS];
+	unsigned head; // next slot to write out
+	unsigned tail; // next slot to fill
+	slot_t slots [MAX_SLOTS];
+};
+
 struct _plugstate_t {
 	int32_t mute;
 	int32_t record;
 	int32_t mute_toggle;
 	int32_t record_toggle;
 	char file_path [PATH_MAX];
+	int32_t compression;
+	int32_t memory;
+	double loop_start;
+	double loop_end;
+	int32_t split;
+	int32_t track_mute;
+	float checkpoint;
+	char next_path [PATH_MAX];
+	int32_t next_bars;
+
+	int64_t events;
+	double first;
+	double last;
+	int32_t rate;
+	float bpm;
+
+	int64_t late;
+	int64_t dropped;
+	float lateness;
+
+	int64_t written;
+	int64_t read;
+	float ratio;
+	float job_latency;
+	float fill;
+	float reposition;
+	int64_t overflows;
 };
 
 struct _plughandle_t {
@@ -89,6 +247,24 @@ struct _plughandle_t {
 		LV2_URID record;
 		LV2_URID mute_toggle;
 		LV2_URID record_toggle;
+		LV2_URID file_path;
+		LV2_URID next_path;
+		LV2_URID events;
+		LV2_URID first;
+		LV2_URID last;
+		LV2_URID rate;
+		LV2_URID bpm;
+		LV2_URID late;
+		LV2_URID dropped;
+		LV2_URID lateness;
+		LV2_URID written;
+		LV2_URID read;
+		LV2_URID ratio;
+		LV2_URID job_latency;
+		LV2_URID fill;
+		LV2_URID reposition;
+		LV2_URID overflows;
+		LV2_URID midi_event;
 	} urid;
 	
 	timely_t timely;
@@ -111,34 +287,188 @@ struct _plughandle_t {
 	varchunk_t *to_dsp;
 	varchunk_t *to_worker;
 
-	uint8_t buf [MAX_BUF];
+	uint8_t buf [BLOCK_SIZE]; // items never straddle blocks
 
 	char path [PATH_MAX];
+	int fd;
 	gzFile gzfile;
+	bool writing;
+	bool raw;
+	int32_t compression;
+	pool_t *pool;
+	bool peeking;
+	item_t itm;
+	double last;
+	z_stream strm;
+	uint64_t fd_offset;
+	uint8_t zbuf [ZBUF_SIZE];
+	uint8_t dict [MAX_DICT];
+
+	struct {
+		double beats;
+		size_t size;
+		uint32_t count;
+		uint32_t tracks;
+		uint8_t buf [BLOCK_SIZE];
+	} blk;
+
+	struct {
+		size_t n;
+		size_t max;
+		entry_t *entries;
+	} index;
+
+	struct {
+		uint8_t *base;
+		size_t size;
+		size_t cur;
+		size_t blk;
+		uint8_t *converted;
+	} mapped;
+
+	// block being streamed, blocks are streamed in order of index
+	struct {
+		size_t blk;
+		uint32_t left; // events of it not consumed yet
+	} cursor;
+
+	// original recording, left untouched while punched in, takes are appended
+	// to the file and referenced by the index written on punch out
+	struct {
+		bool active;
+		bool recorded; // take holds items of its own
+		double from;
+		double until;
+		double last;
+		uint64_t size; // of file, restored when dropping take
+		size_t n;
+		entry_t *entries;
+		uint8_t buf [BLOCK_SIZE];
+	} punch;
+
 	bool draining;
+	uint32_t drain;
+	double horizon; // beats streamed ahead so far
+	bool reading;
+	uint64_t clock; // frames since instantiation
+	uint64_t requested; // clock at last read request
+	uint64_t checkpointed; // clock at last checkpoint request
+	double latency; // read round-trip in frames
+	bool timing;
+	uint64_t repositioned; // clock at last reposition request
+	uint64_t published; // clock at last telemetry update
+	int64_t overflows; // of rt-thread
+	io_t disk; // of worker thread, as last reported
+	float fill; // peak ringbuffer fill since last telemetry update
+	bool telemetry;
+
+	capsule_t *capsule;
+	size_t capsule_pos;
+	double capsule_shift;
+
+	cue_t cues [MAX_CUES];
+	cue_t *cue; // playing from
+	cue_t *capture; // recording into
+	cue_t next; // head of next recording, filled by worker while preloading
+	double next_beats; // switch point to next recording
+	uint32_t next_seq;
+	bool next_pending; // preload requested, or failed
+	bool next_ready;
+	netatom_t *next_netatom; // worker side, for dictionary of next recording
+	size_t cue_pos;
+	uint64_t cue_used;
+	uint32_t load;
+	bool wakeup;
 	char file_path [PATH_MAX];
-};
 
-static const char magic [MAGIC_SIZE] = "netatom"; //FIXME use
+#if defined(USE_IO_THREAD)
+	// drains jobs instead of the host worker, so slow disks stall nobody else
+	struct {
+		pthread_t id;
+		sem_t sem;
+		atomic_bool done;
+		bool running;
+		varchunk_t *responses; // to rt-thread, dispatched in _end_run
+	} thread;
+#endif
+
+	// last checkpoint of recording in place
+	struct {
+		uint64_t offset;
+		size_t n; // index entries covered
+		uint32_t dict; // dictionary entries covered
+	} checkpoint;
+
+	// loop region unrolled into stream, worker side
+	struct {
+		double start;
+		double end;
+		double shift; // of current lap
+	} loop;
+	uint32_t muted; // tracks skipped, worker side
+
+	uint32_t rate;
+	double bpm; // at record time
+	stats_t stats;
+	bool report;
+	io_t io; // worker side
+	io_t reported; // io as last responded
+	bool notify;
+};
 
 static const char *reading_mode = "rb";
-static const char *writing_mode = "wb9";
-
+// defer worker wakeup to end of cycle, see _end_run
 static inline void
 _wakeup(plughandle_t *handle)
 {
-	const int32_t dummy = 0;
+	handle->wakeup = true;
+}
 
-	const LV2_Worker_Status status = handle->sched->schedule_work(
-		handle->sched->handle, sizeof(int32_t), &dummy);
-	if( (status != LV2_WORKER_SUCCESS) && handle->log)
-	{
-		lv2_log_trace(&handle->logger, "%s: work:schedule failed\n", __func__);
-	}
+// job could not be queued for worker
+static inline void
+_overflow(plughandle_t *handle, const char *func)
+{
+	handle->overflows += 1;
+	handle->telemetry = true;
+
+	if(handle->log)
+		lv2_log_trace(&handle->logger, "%s: ringbuffer overflow\n", func);
+}
+
+// reposition has been drained by worker
+static inline void
+_drained(plughandle_t *handle)
+{
+	handle->draining = false;
+	handle->state.reposition = (handle->clock - handle->repositioned) * 1000.f / handle->rate;
+	handle->telemetry = true;
+}
+
+// read-ahead window in beats at current tempo
+static inline double
+_window(plughandle_t *handle)
+{
+	const double bpm = TIMELY_BEATS_PER_MINUTE(&handle->timely);
+
+	return (bpm > 0.0)
+		? READ_AHEAD_MS * bpm / 60000.0
+		: 1.0;
+}
+
+// offset of loop lap containing given beats, zero before first wrap
+static inline double
+_loop_shift(double start, double end, double beats)
+{
+	const double len = end - start;
+
+	if( (len <= 0.0) || (beats < end) )
+		return 0.0;
+
+	return floor( (beats - start) / len) * len;
 }
 
 static inline void
-_request_read(plughandle_t *handle)
+_request_read(plughandle_t *handle, double beats)
 {
 	const size_t tot_size = sizeof(job_t);
 
@@ -146,17 +476,146 @@ _request_read(plughandle_t *handle)
 	if((job = varchunk_write_request(handle->to_worker, tot_size)))
 	{
 		job->type = TC_JOB_READ;
+		job->beats = beats;
+		job->until = beats + _window(handle);
+		job->seq = handle->drain;
 
 		varchunk_write_advance(handle->to_worker, tot_size);
 		_wakeup(handle);
+		handle->reading = true;
+		handle->requested = handle->clock;
 	}
-	else if(handle->log)
+	else
+	{
+		_overflow(handle, __func__);
+	}
+}
+
+// find first event at or after given beats via binary search
+static inline size_t
+_events_find(const event_t *events, size_t n, double beats)
+{
+	size_t lo = 0;
+	size_t hi = n;
+
+	while(lo < hi)
+	{
+		const size_t mid = lo + (hi - lo) / 2;
+
+		if(events[mid].beats < beats)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static inline void
+_cues_clear(plughandle_t *handle)
+{
+	for(unsigned i = 0; i < MAX_CUES; i++)
+		handle->cues[i].valid = false;
+
+	handle->cue = NULL;
+	handle->capture = NULL;
+}
+
+// cached pre-roll covering given beats, if any
+static inline cue_t *
+_cue_find(plughandle_t *handle, double beats)
+{
+	for(unsigned i = 0; i < MAX_CUES; i++)
+	{
+		cue_t *cue = &handle->cues[i];
+
+		if(cue->valid && (beats >= cue->beats) && (beats < cue->until) )
+			return cue;
+	}
+
+	return NULL;
+}
+
+// capture pre-roll after a jump into least recently used cue
+static inline void
+_capture_begin(plughandle_t *handle, double beats)
+{
+	cue_t *lru = NULL;
+
+	for(unsigned i = 0; i < MAX_CUES; i++)
+	{
+		cue_t *cue = &handle->cues[i];
+
+		if(!cue->valid)
+		{
+			lru = cue;
+			break;
+		}
+
+		if(!lru || (cue->used < lru->used) )
+			lru = cue;
+	}
+
+	lru->valid = false;
+	lru->beats = beats;
+	lru->until = beats + CUE_BEATS;
+	lru->used = ++handle->cue_used;
+	lru->n = 0;
+	lru->size = 0;
+
+	handle->capture = lru;
+}
+
+// close capture at given beats, events at or after it are left to the stream
+static inline void
+_capture_end(plughandle_t *handle, double beats)
+{
+	cue_t *cue = handle->capture;
+
+	if(beats < cue->until)
+		cue->until = beats;
+
+	while(cue->n && (cue->events[cue->n - 1].beats >= cue->until) )
 	{
-		lv2_log_trace(&handle->logger, "%s: ringbuffer overflow\n", __func__);
+		cue->n -= 1;
+		cue->size = cue->events[cue->n].offset;
 	}
+
+	cue->valid = cue->until > cue->beats;
+	handle->capture = NULL;
 }
 
+// append event delivered from disk stream to pre-roll being captured
 static inline void
+_capture(plughandle_t *handle, double beats, const LV2_Atom *atom)
+{
+	cue_t *cue = handle->capture;
+
+	if(beats < cue->beats)
+		return;
+
+	if(beats >= cue->until)
+	{
+		_capture_end(handle, cue->until); // complete
+		return;
+	}
+
+	const size_t atom_size = lv2_atom_total_size(atom);
+	if( (cue->n == CUE_EVENTS) || (cue->size + atom_size > CUE_SIZE) )
+	{
+		_capture_end(handle, beats); // truncate
+		return;
+	}
+
+	event_t *ev = &cue->events[cue->n++];
+	ev->beats = beats;
+	ev->offset = cue->size;
+
+	memcpy(&cue->body[cue->size], atom, atom_size);
+	cue->size += lv2_atom_pad_size(atom_size);
+}
+
+static inline int
 _reposition_play(plughandle_t *handle, double beats)
 {
 	const size_t tot_size = sizeof(job_t);
@@ -166,36 +625,137 @@ _reposition_play(plughandle_t *handle, double beats)
 	{
 		job->type = TC_JOB_REPOSITION_PLAY;
 		job->beats = beats;
+		job->until = beats + _window(handle);
+		job->seq = ++handle->drain;
+		job->muted = handle->state.track_mute;
+		job->loop.start = handle->state.loop_start;
+		job->loop.end = handle->state.loop_end;
 
 		varchunk_write_advance(handle->to_worker, tot_size);
 		_wakeup(handle);
 		handle->draining = true;
+		handle->repositioned = handle->clock;
+		handle->horizon = beats;
+		handle->reading = true;
+		handle->requested = handle->clock;
 	}
-	else if(handle->log)
+	else
 	{
-		lv2_log_trace(&handle->logger, "%s: ringbuffer overflow\n", __func__);
+		_overflow(handle, __func__);
+		return -1;
 	}
+
+	handle->cue = NULL;
+	handle->capture = NULL; // unfinished captures stay invalid
+
+	return 0;
 }
 
 static inline void
-_reposition_rec(plughandle_t *handle, double beats)
+_reposition_rec(plughandle_t *handle, double beats, double until)
 {
 	const size_t tot_size = sizeof(job_t);
 
+	_cues_clear(handle); // recording will be changed
+
 	job_t *job;
 	if((job = varchunk_write_request(handle->to_worker, tot_size)))
 	{
 		job->type = TC_JOB_REPOSITION_REC;
 		job->beats = beats;
+		job->until = until;
+		job->bpm = TIMELY_BEATS_PER_MINUTE(&handle->timely);
+		job->seq = ++handle->drain;
+		job->compression = handle->state.compression;
 
 		varchunk_write_advance(handle->to_worker, tot_size);
 		_wakeup(handle);
 		handle->draining = true;
+		handle->repositioned = handle->clock;
+		handle->checkpointed = handle->clock;
 	}
-	else if(handle->log)
+	else
+	{
+		_overflow(handle, __func__);
+	}
+}
+
+static inline void
+_request_checkpoint(plughandle_t *handle)
+{
+	const size_t tot_size = sizeof(job_t);
+
+	job_t *job;
+	if((job = varchunk_write_request(handle->to_worker, tot_size)))
+	{
+		job->type = TC_JOB_CHECKPOINT;
+
+		varchunk_write_advance(handle->to_worker, tot_size);
+		_wakeup(handle);
+	}
+	else
+	{
+		_overflow(handle, __func__);
+	}
+
+	handle->checkpointed = handle->clock;
+}
+
+static inline void
+_request_load(plughandle_t *handle)
+{
+	const size_t tot_size = sizeof(job_t);
+
+	job_t *job;
+	if((job = varchunk_write_request(handle->to_worker, tot_size)))
+	{
+		job->type = TC_JOB_LOAD;
+		job->seq = ++handle->load;
+
+		varchunk_write_advance(handle->to_worker, tot_size);
+		_wakeup(handle);
+	}
+	else
+	{
+		_overflow(handle, __func__);
+	}
+}
+
+// hand capsule back to worker for freeing
+static inline void
+_capsule_release(plughandle_t *handle)
+{
+	if(!handle->capsule)
+		return;
+
+	const size_t tot_size = sizeof(job_t);
+
+	job_t *job;
+	if((job = varchunk_write_request(handle->to_worker, tot_size)))
+	{
+		job->type = TC_JOB_FREE;
+		job->capsule = handle->capsule;
+
+		varchunk_write_advance(handle->to_worker, tot_size);
+		_wakeup(handle);
+	}
+	else
 	{
-		lv2_log_trace(&handle->logger, "%s: ringbuffer overflow\n", __func__);
+		_overflow(handle, __func__);
 	}
+
+	handle->capsule = NULL;
+}
+
+// find first event at or after given beats within its loop lap
+static inline void
+_capsule_seek(plughandle_t *handle, double beats)
+{
+	const capsule_t *capsule = handle->capsule;
+	const double shift = _loop_shift(handle->state.loop_start, handle->state.loop_end, beats);
+
+	handle->capsule_pos = _events_find(capsule->events, capsule->n, beats - shift);
+	handle->capsule_shift = shift;
 }
 
 static void
@@ -232,44 +792,219 @@ _record_intercept(void *data, int64_t frames, props_impl_t *impl)
 		return;
 
 	if(handle->state.record)
-		_reposition_rec(handle, beats);
+	{
+		_capsule_release(handle); // will be stale
+		_reposition_rec(handle, beats, beats);
+	}
 	else
-		_reposition_play(handle, beats);
+	{
+		_reposition_play(handle, beats); // stream until (re)loaded
+		if(handle->state.memory)
+			_request_load(handle);
+	}
 }
 
 static void
-_path_intercept(void *data, int64_t frames, props_impl_t *impl)
+_loop_intercept(void *data, int64_t frames, props_impl_t *impl)
 {
 	plughandle_t *handle = data;
 
-	const size_t len = strlen(handle->state.file_path) + 1;
-	const size_t tot_size = sizeof(job_t) + len;
+	_cues_clear(handle); // captured with previous loop region
+
+	if(handle->state.record)
+		return; // only applies to playback
+
+	const double beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
+	if(!isfinite(beats))
+		return;
+
+	if(handle->capsule)
+		_capsule_seek(handle, beats);
+	else
+		_reposition_play(handle, beats); // unroll stream anew
+}
+
+static void
+_track_mute_intercept(void *data, int64_t frames, props_impl_t *impl)
+{
+	plughandle_t *handle = data;
+
+	_cues_clear(handle); // captured with previous track mutes
+
+	if(handle->state.record || handle->capsule)
+		return; // filtered while playing from memory
+
 	const double beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
 	if(!isfinite(beats))
 		return;
 
+	_reposition_play(handle, beats); // stream anew without muted tracks
+}
+
+static void
+_memory_intercept(void *data, int64_t frames, props_impl_t *impl)
+{
+	plughandle_t *handle = data;
+
+	if(handle->state.record)
+		return; // loaded when recording stops
+
+	if(handle->state.memory)
+	{
+		if(!handle->capsule)
+			_request_load(handle);
+	}
+	else if(handle->capsule)
+	{
+		_capsule_release(handle);
+
+		const double beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
+		if(isfinite(beats))
+			_reposition_play(handle, beats);
+	}
+}
+
+// reopen recording at state.file_path and continue streaming at given beats
+static inline void
+_change_path(plughandle_t *handle, double beats)
+{
+	const size_t len = strlen(handle->state.file_path) + 1;
+	const size_t tot_size = sizeof(job_t) + len;
+
+	_cues_clear(handle); // refer to previous recording
+
 	job_t *job;
 	if((job = varchunk_write_request(handle->to_worker, tot_size)))
 	{
 		job->beats = beats;
 		job->type = TC_JOB_CHANGE_PATH;
+		job->seq = ++handle->drain;
+		job->muted = handle->state.track_mute;
+		job->loop.start = handle->state.loop_start;
+		job->loop.end = handle->state.loop_end;
 		snprintf(job->file_path, len, "%s", handle->state.file_path);
 
 		varchunk_write_advance(handle->to_worker, tot_size);
 		_wakeup(handle);
+		handle->draining = true;
+		handle->repositioned = handle->clock;
+		handle->horizon = beats; // read-ahead restarts from here
+		handle->reading = false;
 	}
-	else if(handle->log)
+	else
 	{
-		lv2_log_trace(&handle->logger, "%s: ringbuffer overflow\n", __func__);
+		_overflow(handle, __func__);
 	}
+
+	_capsule_release(handle);
+	if(handle->state.memory && !handle->state.record)
+		_request_load(handle);
 }
 
-static const props_def_t defs [MAX_NPROPS] = {
-	{
-		.property = ORBIT_URI"#timecapsule_mute",
-		.offset = offsetof(plugstate_t, mute),
-		.type = LV2_ATOM__Bool,
-		.event_cb = _mute_intercept
+static void
+_path_intercept(void *data, int64_t frames, props_impl_t *impl)
+{
+	plughandle_t *handle = data;
+
+	const double beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
+	if(isfinite(beats))
+		_change_path(handle, beats);
+}
+
+// have worker decode head of next recording up to the next bar boundary
+static inline void
+_request_preload(plughandle_t *handle, double beats)
+{
+	const size_t len = strlen(handle->state.next_path) + 1;
+	const size_t tot_size = sizeof(job_t) + len;
+
+	// switch at next multiple of bars, leaving the worker some time
+	const int32_t bars = (handle->state.next_bars > 1) ? handle->state.next_bars : 1;
+	const double bar = TIMELY_BEATS_PER_BAR(&handle->timely) * bars;
+	if(bar <= 0.0)
+		return;
+	const double next = (floor( (beats + _window(handle)) / bar) + 1.0) * bar;
+
+	job_t *job;
+	if((job = varchunk_write_request(handle->to_worker, tot_size)))
+	{
+		job->type = TC_JOB_PRELOAD;
+		job->beats = next;
+		job->seq = ++handle->next_seq;
+		job->muted = handle->state.track_mute;
+		job->loop.start = handle->state.loop_start;
+		job->loop.end = handle->state.loop_end;
+		snprintf(job->file_path, len, "%s", handle->state.next_path);
+
+		varchunk_write_advance(handle->to_worker, tot_size);
+		_wakeup(handle);
+		handle->next_pending = true;
+	}
+	else
+	{
+		_overflow(handle, __func__);
+	}
+}
+
+// notify about path changed on the rt-thread, its length may have changed
+static inline void
+_path_set(plughandle_t *handle, LV2_URID property, const char *path)
+{
+	props_impl_t *impl = _props_impl_get(&handle->props, property);
+	if(impl)
+		impl->value.size = strlen(path) + 1;
+
+	props_set(&handle->props, &handle->forge, 0, property, &handle->ref);
+}
+
+// continue with preloaded head of next recording while disk stream reopens
+static inline void
+_next_switch(plughandle_t *handle, double beats)
+{
+	snprintf(handle->state.file_path, PATH_MAX, "%s", handle->state.next_path);
+	handle->state.next_path[0] = '\0';
+	handle->next_ready = false;
+
+	_path_set(handle, handle->urid.file_path, handle->state.file_path);
+	_path_set(handle, handle->urid.next_path, handle->state.next_path);
+
+	_change_path(handle, handle->next.until);
+
+	handle->cue = &handle->next;
+	handle->cue_pos = _events_find(handle->next.events, handle->next.n, beats);
+}
+
+static void
+_next_intercept(void *data, int64_t frames, props_impl_t *impl)
+{
+	plughandle_t *handle = data;
+
+	if(handle->state.next_bars < 1)
+		handle->state.next_bars = 1;
+
+	// outdate preload in flight, if any, a new one is requested from run
+	handle->next_seq += 1;
+	handle->next_pending = false;
+	handle->next_ready = false;
+}
+
+static void
+_compression_intercept(void *data, int64_t frames, props_impl_t *impl)
+{
+	plughandle_t *handle = data;
+
+	if(handle->state.compression < TC_COMPRESSION_NONE)
+		handle->state.compression = TC_COMPRESSION_NONE;
+	else if(handle->state.compression > TC_COMPRESSION_BEST)
+		handle->state.compression = TC_COMPRESSION_BEST;
+}
+
+static const props_def_t defs [MAX_NPROPS] = {
+	{
+		.property = ORBIT_URI"#timecapsule_mute",
+		.offset = offsetof(plugstate_t, mute),
+		.type = LV2_ATOM__Bool,
+		.event_cb = _mute_intercept
 	},
 	{
 		.property = ORBIT_URI"#timecapsule_record",
@@ -295,16 +1030,295 @@ static const props_def_t defs [MAX_NPROPS] = {
 		.type = LV2_ATOM__Path,
 		.event_cb = _path_intercept,
 		.max_size = PATH_MAX
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_next_path",
+		.offset = offsetof(plugstate_t, next_path),
+		.type = LV2_ATOM__Path,
+		.event_cb = _next_intercept,
+		.max_size = PATH_MAX
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_next_bars",
+		.offset = offsetof(plugstate_t, next_bars),
+		.type = LV2_ATOM__Int,
+		.event_cb = _next_intercept
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_compression",
+		.offset = offsetof(plugstate_t, compression),
+		.type = LV2_ATOM__Int,
+		.event_cb = _compression_intercept
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_memory",
+		.offset = offsetof(plugstate_t, memory),
+		.type = LV2_ATOM__Bool,
+		.event_cb = _memory_intercept
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_loop_start",
+		.offset = offsetof(plugstate_t, loop_start),
+		.type = LV2_ATOM__Double,
+		.event_cb = _loop_intercept
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_loop_end",
+		.offset = offsetof(plugstate_t, loop_end),
+		.type = LV2_ATOM__Double,
+		.event_cb = _loop_intercept
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_split",
+		.offset = offsetof(plugstate_t, split),
+		.type = LV2_ATOM__Bool
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_track_mute",
+		.offset = offsetof(plugstate_t, track_mute),
+		.type = LV2_ATOM__Int,
+		.event_cb = _track_mute_intercept
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_checkpoint",
+		.offset = offsetof(plugstate_t, checkpoint),
+		.type = LV2_ATOM__Float
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_events",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, events),
+		.type = LV2_ATOM__Long
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_first",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, first),
+		.type = LV2_ATOM__Double
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_last",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, last),
+		.type = LV2_ATOM__Double
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_rate",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, rate),
+		.type = LV2_ATOM__Int
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_bpm",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, bpm),
+		.type = LV2_ATOM__Float
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_late",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, late),
+		.type = LV2_ATOM__Long
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_dropped",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, dropped),
+		.type = LV2_ATOM__Long
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_lateness",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, lateness),
+		.type = LV2_ATOM__Float
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_written",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, written),
+		.type = LV2_ATOM__Long
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_read",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, read),
+		.type = LV2_ATOM__Long
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_ratio",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, ratio),
+		.type = LV2_ATOM__Float
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_job_latency",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, job_latency),
+		.type = LV2_ATOM__Float
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_fill",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, fill),
+		.type = LV2_ATOM__Float
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_reposition",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, reposition),
+		.type = LV2_ATOM__Float
+	},
+	{
+		.property = ORBIT_URI"#timecapsule_overflows",
+		.access = LV2_PATCH__readable,
+		.offset = offsetof(plugstate_t, overflows),
+		.type = LV2_ATOM__Long
 	}
 };
 
+// forge event at period offset, late events are accounted for and sent asap
+static inline void
+_deliver(plughandle_t *handle, int64_t frames, const LV2_Atom *atom)
+{
+	if(frames < 0)
+	{
+		const float lateness = -frames * 1000.f / handle->rate;
+
+		handle->state.late += 1;
+		if(lateness > handle->state.lateness)
+			handle->state.lateness = lateness;
+		handle->timing = true;
+
+		frames = 0;
+	}
+
+	if(handle->ref)
+		handle->ref = lv2_atom_forge_frame_time(&handle->forge, frames);
+	if(handle->ref)
+		handle->ref = lv2_atom_forge_write(&handle->forge, atom, lv2_atom_total_size(atom));
+
+	if(!handle->ref)
+	{
+		handle->state.dropped += 1;
+		handle->timing = true;
+	}
+}
+
+// play from memory, seeking is done on the rt-thread itself
+static inline void
+_play_capsule(plughandle_t *handle, int64_t to)
+{
+	const capsule_t *capsule = handle->capsule;
+	const uint8_t *body = (const uint8_t *)&capsule->events[capsule->n];
+	const int64_t rel = handle->offset - to; // beginning of current period
+
+	// discard streamed events, so the ringbuffer never stalls
+	const job_t *job;
+	size_t tot_size;
+	while((job = varchunk_read_request(handle->to_dsp, &tot_size)))
+	{
+		if( (job->type == TC_JOB_DRAIN) && handle->draining && (job->seq == handle->drain) )
+			_drained(handle);
+
+		varchunk_read_advance(handle->to_dsp);
+	}
+
+	const double loop_start = handle->state.loop_start;
+	const double loop_end = handle->state.loop_end;
+	const double len = loop_end - loop_start;
+
+	while(true)
+	{
+		const event_t *ev = (handle->capsule_pos < capsule->n)
+			? &capsule->events[handle->capsule_pos]
+			: NULL;
+
+		if(ev && ( (len <= 0.0) || (ev->beats < loop_end) ) )
+		{
+			const int64_t beat_frames = (ev->beats + handle->capsule_shift)
+				* TIMELY_FRAMES_PER_BEAT(&handle->timely);
+
+			if(beat_frames >= handle->offset)
+				break; // event not part of this period
+
+			const LV2_Atom *atom = (const LV2_Atom *)&body[ev->offset];
+
+			if(!(handle->state.track_mute & (1U << ev->track)))
+				_deliver(handle, beat_frames - rel, atom);
+			handle->capsule_pos += 1;
+			continue;
+		}
+
+		// end of recording or loop lap, wrap once play head gets there
+		const int64_t wrap_frames = (loop_end + handle->capsule_shift)
+			* TIMELY_FRAMES_PER_BEAT(&handle->timely);
+
+		if( (len <= 0.0) || (wrap_frames >= handle->offset) )
+			break;
+
+		handle->capsule_pos = _events_find(capsule->events, capsule->n, loop_start);
+		handle->capsule_shift += len;
+	}
+}
+
+// play back cached pre-roll while disk stream catches up behind it
+static inline void
+_play_cue(plughandle_t *handle, int64_t rel)
+{
+	const cue_t *cue = handle->cue;
+
+	for( ; handle->cue_pos < cue->n; handle->cue_pos++)
+	{
+		const event_t *ev = &cue->events[handle->cue_pos];
+		const int64_t beat_frames = ev->beats * TIMELY_FRAMES_PER_BEAT(&handle->timely);
+
+		if(beat_frames >= handle->offset)
+			return; // event not part of this period
+
+		_deliver(handle, beat_frames - rel, (const LV2_Atom *)&cue->body[ev->offset]);
+	}
+
+	handle->cue = NULL; // exhausted, stream continues at cue->until
+}
+
+// jump to cached pre-roll if possible, otherwise capture one for next time
+static inline void
+_jump(plughandle_t *handle, double beats)
+{
+	cue_t *capture = handle->capture;
+	if(capture) // keep what has been streamed so far
+		_capture_end(handle, capture->n ? capture->events[capture->n - 1].beats : capture->beats);
+
+	cue_t *cue = _cue_find(handle, beats);
+	if(cue)
+	{
+		if(_reposition_play(handle, cue->until) == 0)
+		{
+			cue->used = ++handle->cue_used;
+			handle->cue = cue;
+			handle->cue_pos = _events_find(cue->events, cue->n, beats);
+		}
+	}
+	else if(_reposition_play(handle, beats) == 0)
+	{
+		_capture_begin(handle, beats);
+	}
+}
+
 static inline void
 _play(plughandle_t *handle, int64_t to)
 {
-	bool consumed = false;
+	if(handle->capsule)
+	{
+		_play_capsule(handle, to);
+		return;
+	}
 
 	const int64_t rel = handle->offset - to; // beginning of current period
 
+	if(handle->cue)
+		_play_cue(handle, rel);
+
 	const job_t *job;
 	size_t tot_size;
 	while((job = varchunk_read_request(handle->to_dsp, &tot_size)))
@@ -312,52 +1326,86 @@ _play(plughandle_t *handle, int64_t to)
 		switch(job->type)
 		{
 			case TC_JOB_WRITE:
+			case TC_JOB_MAPPED:
 			{
 				if(handle->draining)
-					break; // ignore while draining
+					break; // ignore while draining, mapped memory may be gone already
 
 				const int64_t beat_frames = job->beats * TIMELY_FRAMES_PER_BEAT(&handle->timely);
 
 				if(beat_frames >= handle->offset)
 					goto skip; // event not part of this period
 
-				int64_t frames = beat_frames - rel;
-				if(frames < 0)
-					frames = 0; //FIXME
+				// forge straight from memory-mapped recording, if any
+				const LV2_Atom *atom = (job->type == TC_JOB_MAPPED)
+					? job->ref
+					: job->atom;
 
-				//printf("%li %u\n", frames, job->atom->size);
+				_deliver(handle, beat_frames - rel, atom);
 
-				if(handle->ref)
-					handle->ref = lv2_atom_forge_frame_time(&handle->forge, frames);
-				if(handle->ref)
-					handle->ref = lv2_atom_forge_write(&handle->forge, job->atom, lv2_atom_total_size(job->atom));
+				if(handle->capture)
+					_capture(handle, job->beats, atom);
 			} break;
 
 			case TC_JOB_DRAIN:
 			{
-				if(handle->draining)
-					handle->draining = false;
+				// only the latest reposition ends draining
+				if(handle->draining && (job->seq == handle->drain) )
+					_drained(handle);
 			} break;
 
 			case TC_JOB_CHANGE_PATH:
 			case TC_JOB_REPOSITION_PLAY:
 			case TC_JOB_READ:
 			case TC_JOB_REPOSITION_REC:
+			case TC_JOB_LOAD:
+			case TC_JOB_FREE:
+			case TC_JOB_STATS:
+			case TC_JOB_CHECKPOINT:
+			case TC_JOB_IO:
+			case TC_JOB_PRELOAD:
 			{
 				// nothing to do
 			} break;
 		}
 
 		varchunk_read_advance(handle->to_dsp);
-		consumed = true;
 		continue;
 
 skip:
 		break;
 	}
 
-	if(consumed)
-		_request_read(handle);
+	// refill once play head has consumed half of the read-ahead window, or
+	// earlier if the worker takes longer than that to respond
+	const double beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
+	const double lookahead = fmax(_window(handle) / 2,
+		2 * handle->latency / TIMELY_FRAMES_PER_BEAT(&handle->timely));
+	if(  handle->reading
+		&& (handle->clock - handle->requested >= READ_TIMEOUT_MS * handle->rate / 1000) )
+	{
+		// response got lost (counted as overflow by worker), request anew
+		handle->reading = false;
+
+		if(handle->log)
+			lv2_log_trace(&handle->logger, "%s: read-ahead timed out\n", __func__);
+	}
+	if(!handle->reading && isfinite(beats) && (beats + lookahead >= handle->horizon) )
+		_request_read(handle, fmax(beats, handle->horizon));
+}
+
+// MIDI channel messages are split to tracks 1-16, everything else to track 0
+static inline uint32_t
+_track(plughandle_t *handle, const LV2_Atom *atom)
+{
+	if(!handle->state.split || (atom->type != handle->urid.midi_event) || !atom->size)
+		return 0;
+
+	const uint8_t status = *(const uint8_t *)LV2_ATOM_BODY_CONST(atom);
+	if( !(status & 0x80) || ( (status & 0xf0) == 0xf0) )
+		return 0; // system message
+
+	return 1 + (status & 0x0f);
 }
 
 static inline void
@@ -372,14 +1420,15 @@ _rec(plughandle_t *handle, const LV2_Atom_Event *ev)
 	{
 		job->type = TC_JOB_WRITE;
 		job->beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
+		job->track = _track(handle, atom);
 		memcpy(job->atom, atom, atom_size);
 
 		varchunk_write_advance(handle->to_worker, tot_size);
 		_wakeup(handle);
 	}
-	else if(handle->log)
+	else
 	{
-		lv2_log_trace(&handle->logger, "%s: ringbuffer overflow\n", __func__);
+		_overflow(handle, __func__);
 	}
 }
 
@@ -399,210 +1448,2633 @@ _cb(timely_t *timely, int64_t frames, LV2_URID type, void *data)
 		if(!isfinite(beats))
 			return;
 
+		const double until = handle->offset / TIMELY_FRAMES_PER_BEAT(timely);
 		handle->offset = beats * TIMELY_FRAMES_PER_BEAT(timely);
 
 		if(handle->state.record)
-			_reposition_rec(handle, beats);
+			_reposition_rec(handle, beats, until); // punch out at previous position
+		else if(handle->capsule)
+			_capsule_seek(handle, beats); // no worker round-trip needed
 		else
-			_reposition_play(handle, beats);
+			_jump(handle, beats);
 	}
 }
 
 static inline void
-_close_disk(plughandle_t *handle)
+_index_clear(plughandle_t *handle)
 {
-	if(handle->gzfile)
-	{
-		gzclose(handle->gzfile);
-		handle->gzfile = NULL;
-	}
+	handle->index.n = 0;
 }
 
 static inline int
-_read_header(plughandle_t *handle, double *beats, uint32_t *size)
+_index_append(plughandle_t *handle, double beats, uint64_t offset, uint32_t count,
+	uint32_t tracks, uint32_t size)
 {
-	item_t itm;
-
-	if(gzfread(&itm, sizeof(item_t), 1, handle->gzfile) != 1)
+	if(handle->index.n >= handle->index.max)
 	{
-		int errnum;
-		const char *err = gzerror(handle->gzfile, &errnum);
-		if( (errnum != Z_OK) && handle->log)
-		{
-			lv2_log_error(&handle->logger, "%s: gzfread failed: %s\n", __func__, err);
-		}
-		return -1;
-	}
+		const size_t max = handle->index.max ? handle->index.max * 2 : 1024;
+		entry_t *entries = realloc(handle->index.entries, max * sizeof(entry_t));
+		if(!entries)
+			return -1;
 
-	itm.beats.u = be64toh(itm.beats.u);
-	itm.size = be32toh(itm.size);
+		handle->index.entries = entries;
+		handle->index.max = max;
+	}
 
-	if(beats)
-		*beats = itm.beats.d;
-	if(size)
-		*size = itm.size;
+	entry_t *entry = &handle->index.entries[handle->index.n++];
+	entry->beats = beats;
+	entry->offset = offset;
+	entry->count = count;
+	entry->tracks = tracks;
+	entry->size = size;
 
 	return 0;
 }
 
+// sizes of blocks are not stored by legacy formats, their blocks lie back to
+// back in the file, though
 static inline void
-_reopen_disk(plughandle_t *handle, bool writing, double beats)
+_index_extents(plughandle_t *handle, uint64_t end)
 {
-	_close_disk(handle);
-
-	z_off_t offset = 0;
+	entry_t *entries = handle->index.entries;
 
-	if(beats > 0.0)
+	for(size_t i = 0; i < handle->index.n; i++)
 	{
-		handle->gzfile = gzopen(handle->file_path, reading_mode);
-		if(!handle->gzfile)
+		if(entries[i].size == 0)
 		{
-			if(handle->log)
-			{
-				lv2_log_error(&handle->logger, "%s: gzopen failed: %s '%s'\n",
-					__func__, handle->file_path, strerror(errno));
-			}
-			goto stage_2;
+			entries[i].size = ( (i + 1 < handle->index.n) ? entries[i + 1].offset : end)
+				- entries[i].offset;
 		}
+	}
+}
 
-		double _beats;
-		uint32_t _size;
-		while(_read_header(handle, &_beats, &_size) == 0)
-		{
-			if(_beats >= beats) // found point of interest
-			{
-				break;
-			}
-			else
-			{
-				const int res = gzseek(handle->gzfile, _size, SEEK_CUR); // skip item payload
-				if( (res == -1) && handle->log)
-				{
-					lv2_log_error(&handle->logger, "%s: gzseek failed: %s '%s'\n",
-						__func__, handle->file_path, strerror(errno));
-					break;
-				}
-			}
+// find last block starting before given beats via binary search
+static inline size_t
+_entries_find(const entry_t *entries, size_t n, double beats)
+{
+	size_t lo = 0;
+	size_t hi = n;
 
-			offset = gztell(handle->gzfile);
-		}
+	while(hi - lo > 1)
+	{
+		const size_t mid = lo + (hi - lo) / 2;
 
-		_close_disk(handle);
+		if(entries[mid].beats < beats)
+			lo = mid;
+		else
+			hi = mid;
 	}
 
-stage_2:
-	handle->gzfile = gzopen(handle->file_path, writing ? writing_mode : reading_mode);
-	if(!handle->gzfile)
-	{
-		if(handle->log)
-		{
-			lv2_log_error(&handle->logger, "%s: gzopen failed: %s '%s'\n",
-				__func__, handle->file_path, strerror(errno));
-		}
-		return;
-	}
+	return lo;
+}
 
-	if(offset > 0)
+static inline size_t
+_index_find(plughandle_t *handle, double beats)
+{
+	return _entries_find(handle->index.entries, handle->index.n, beats);
+}
+
+// serialize pending shared dictionary entries, prefixed by their base index
+static inline int
+_dict_pending(plughandle_t *handle, size_t *size)
+{
+	uint32_t base;
+	size_t dict_size;
+	if(!netatom_shared_pending(handle->netatom, handle->dict + sizeof(uint32_t),
+		MAX_DICT - sizeof(uint32_t), &base, &dict_size))
 	{
-		const int res = gzseek(handle->gzfile, offset, SEEK_SET);
-		if( (res == -1) && handle->log)
-		{
-			lv2_log_error(&handle->logger, "%s: gzseek failed: %s '%s'\n",
-				__func__, handle->file_path, strerror(errno));
-		}
+		return -1;
 	}
+
+	base = htobe32(base);
+	memcpy(handle->dict, &base, sizeof(uint32_t));
+	*size = dict_size ? sizeof(uint32_t) + dict_size : 0;
+
+	return 0;
 }
 
+// deserialize shared dictionary entries, prefixed by their base index
 static inline int
-_write_to(plughandle_t *handle, double beats, const LV2_Atom *atom)
+_dict_parse(netatom_t *netatom, const uint8_t *buf, uint32_t size)
 {
-	//printf("_write\n");
-	if(!handle->gzfile)
+	if(size < sizeof(uint32_t))
 		return -1;
 
-	memcpy(handle->buf, atom, lv2_atom_total_size(atom));
+	uint32_t base;
+	memcpy(&base, buf, sizeof(uint32_t));
 
-	size_t rx_size;
-	const uint8_t *rx_body = netatom_serialize(handle->netatom, (LV2_Atom *)handle->buf, MAX_BUF, &rx_size);
-	if(rx_body)
-	{
-		item_t itm = {
-			.beats.d = beats,
-			.size = rx_size
+	return netatom_shared_append(netatom, be32toh(base),
+		buf + sizeof(uint32_t), size - sizeof(uint32_t));
+}
+
+static inline int
+_dict_load(plughandle_t *handle, gzFile gzfile, uint32_t size)
+{
+	if( (size < sizeof(uint32_t)) || (size > MAX_DICT) )
+		return -1;
+
+	if(gzfread(handle->dict, size, 1, gzfile) != 1)
+		return -1;
+
+	return _dict_parse(handle->netatom, handle->dict, size);
+}
+
+static inline int
+_index_load(plughandle_t *handle)
+{
+	_index_clear(handle);
+
+	// look for footer, either raw or wrapped in a stored gzip member
+	uint8_t tail [sizeof(footer_t) + GZIP_TRAILER_SIZE];
+	const off_t size = lseek(handle->fd, 0, SEEK_END);
+	if(size < (off_t)sizeof(tail))
+		return -1;
+
+	if(  (lseek(handle->fd, size - sizeof(tail), SEEK_SET) == -1)
+		|| (read(handle->fd, tail, sizeof(tail)) != sizeof(tail)) )
+		return -1;
+
+	footer_t footer;
+	if(_footer_find(tail, &footer) != 0)
+		return -1; // not properly closed, no index available
+
+	const uint32_t version = be32toh(footer.version);
+	if( (version < 1) || (version > FORMAT_VERSION) )
+		return -1;
+
+	const off_t offset = be64toh(footer.index);
+	if( (offset >= size) || (lseek(handle->fd, offset, SEEK_SET) == -1) )
+		return -1;
+
+	gzFile gzfile = gzdopen(dup(handle->fd), reading_mode);
+	if(!gzfile)
+		return -1;
+
+	item_t itm;
+	uint32_t n;
+	if(  (gzfread(&itm, sizeof(item_t), 1, gzfile) != 1)
+		|| (itm.size != 0)
+		|| (gzfread(&n, sizeof(uint32_t), 1, gzfile) != 1) )
+	{
+		gzclose(gzfile);
+		return -1;
+	}
+
+	// all events of legacy recordings are on first track
+	const size_t entry_size = _entry_size(version);
+	n = be32toh(n);
+	for(uint32_t i = 0; i < n; i++)
+	{
+		entry_t entry = {
+			.tracks = htobe32(1)
 		};
-		itm.beats.u = htobe64(itm.beats.u);
-		itm.size = htobe32(itm.size);
+		if(gzfread(&entry, entry_size, 1, gzfile) != 1)
+		{
+			gzclose(gzfile);
+			_index_clear(handle);
+			return -1;
+		}
+
+		if(_index_append(handle, _double_from_be(&entry.beats), be64toh(entry.offset),
+			be32toh(entry.count), be32toh(entry.tracks), be32toh(entry.size)) != 0)
+		{
+			gzclose(gzfile);
+			_index_clear(handle);
+			return -1;
+		}
+	}
+	_index_extents(handle, offset);
+
+	// complete shared dictionary, so seeks need not scan for it
+	uint32_t dict_size;
+	if(gzfread(&dict_size, sizeof(uint32_t), 1, gzfile) == 1)
+	{
+		if(_dict_load(handle, gzfile, be32toh(dict_size)) != 0)
+		{
+			gzclose(gzfile);
+			_index_clear(handle);
+			netatom_shared_reset(handle->netatom);
+			return -1;
+		}
+	}
+
+	gzclose(gzfile);
+	handle->fd_offset = offset; // recorded data ends in front of index
+
+	handle->stats.events = be64toh(footer.events);
+	handle->stats.first = _double_from_be(&footer.first);
+	handle->stats.last = _double_from_be(&footer.last);
+
+	return 0;
+}
+
+// write buffer as independent gzip member, e.g. a sync point for seeking
+static inline int
+_member_write(plughandle_t *handle, const void *buf, size_t size)
+{
+	if(handle->raw)
+	{
+		if(write(handle->fd, buf, size) != (ssize_t)size)
+		{
+			if(handle->log)
+			{
+				lv2_log_error(&handle->logger, "%s: write failed: %s '%s'\n",
+					__func__, handle->file_path, strerror(errno));
+			}
+			return -1;
+		}
+
+		handle->fd_offset += size;
+		handle->io.written += size;
+
+		return 0;
+	}
+
+	z_stream *strm = &handle->strm;
+
+	strm->next_in = (Bytef *)buf;
+	strm->avail_in = size;
+
+	do
+	{
+		strm->next_out = handle->zbuf;
+		strm->avail_out = ZBUF_SIZE;
+
+		if(deflate(strm, Z_FINISH) == Z_STREAM_ERROR)
+			return -1;
+
+		const size_t len = ZBUF_SIZE - strm->avail_out;
+		if(write(handle->fd, handle->zbuf, len) != (ssize_t)len)
+		{
+			if(handle->log)
+			{
+				lv2_log_error(&handle->logger, "%s: write failed: %s '%s'\n",
+					__func__, handle->file_path, strerror(errno));
+			}
+			deflateReset(strm);
+			return -1;
+		}
+
+		handle->fd_offset += len;
+		handle->io.written += len;
+	} while(strm->avail_out == 0);
+
+	deflateReset(strm);
+
+	return 0;
+}
+
+// write buffer as stored gzip member (or raw), so that its payload can be
+// found verbatim in the file
+static inline int
+_stored_write(plughandle_t *handle, const void *buf, uint16_t size)
+{
+	if(handle->raw)
+		return _member_write(handle, buf, size);
+
+	uint8_t head [GZIP_HEADER_SIZE];
+	uint8_t tail [GZIP_TRAILER_SIZE];
+	_stored_wrap(buf, size, head, tail);
+
+	if(  (write(handle->fd, head, sizeof(head)) != sizeof(head))
+		|| (write(handle->fd, buf, size) != size)
+		|| (write(handle->fd, tail, sizeof(tail)) != sizeof(tail)) )
+	{
+		return -1;
+	}
+
+	handle->fd_offset += sizeof(head) + size + sizeof(tail);
+	handle->io.written += sizeof(head) + size + sizeof(tail);
+
+	return 0;
+}
+
+// write footer so that it can be found at a fixed offset from the end of the
+// file
+static inline int
+_footer_write(plughandle_t *handle, uint64_t index)
+{
+	uint64_t events = 0;
+	for(size_t i = 0; i < handle->index.n; i++)
+		events += handle->index.entries[i].count;
+
+	footer_t footer;
+	memcpy(footer.magic, magic, MAGIC_SIZE);
+	footer.version = htobe32(FORMAT_VERSION);
+	footer.events = htobe64(events);
+	_double_to_be(&footer.first, handle->index.n ? handle->index.entries[0].beats : 0.0);
+	_double_to_be(&footer.last, events ? handle->stats.last : 0.0);
+	footer.index = htobe64(index);
+
+	return _stored_write(handle, &footer, sizeof(footer_t));
+}
+
+// write header as meta item in its own member, ahead of the first block
+static inline int
+_header_write(plughandle_t *handle)
+{
+	struct {
+		item_t itm;
+		header_t header;
+	} __attribute__((packed)) meta;
+
+	meta.itm.beats.u = 0;
+	meta.itm.size = htobe32(sizeof(header_t) | ITEM_FLAG_META);
+	memcpy(meta.header.magic, magic, MAGIC_SIZE);
+	meta.header.version = htobe32(FORMAT_VERSION);
+	meta.header.rate = htobe32(handle->rate);
+	_double_to_be(&meta.header.bpm, handle->bpm);
+
+	return _member_write(handle, &meta, sizeof(meta));
+}
+
+static inline int
+_header_load(plughandle_t *handle)
+{
+	if(lseek(handle->fd, 0, SEEK_SET) == -1)
+		return -1;
+
+	gzFile gzfile = gzdopen(dup(handle->fd), reading_mode);
+	if(!gzfile)
+		return -1;
+
+	item_t itm;
+	header_t header;
+	const int res = (gzfread(&itm, sizeof(item_t), 1, gzfile) == 1)
+		&& (be32toh(itm.size) == (sizeof(header_t) | ITEM_FLAG_META))
+		&& (gzfread(&header, sizeof(header_t), 1, gzfile) == 1)
+		&& !memcmp(header.magic, magic, MAGIC_SIZE);
+	gzclose(gzfile);
+
+	if(!res)
+	{
+		if(handle->log)
+		{
+			lv2_log_note(&handle->logger, "%s: no header found: '%s'\n",
+				__func__, handle->file_path);
+		}
+		return 0; // legacy recording or empty file
+	}
+
+	const uint32_t version = be32toh(header.version);
+	if( (version < 1) || (version > FORMAT_VERSION) )
+	{
+		if(handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: unsupported format version %u: '%s'\n",
+				__func__, version, handle->file_path);
+		}
+		return -1;
+	}
+
+	handle->stats.rate = be32toh(header.rate);
+	handle->stats.bpm = _double_from_be(&header.bpm);
+
+	return 0;
+}
 
-		const int written = gzfwrite(&itm, sizeof(item_t), 1, handle->gzfile)
-			+ gzfwrite(rx_body, rx_size, 1, handle->gzfile);
+// compression thread, deflates pending blocks into independent gzip members
+static void *
+_pool_thread(void *data)
+{
+	pool_t *pool = data;
+
+	z_stream strm;
+	memset(&strm, 0x0, sizeof(z_stream));
+	const bool valid = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+		15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+
+	pthread_mutex_lock(&pool->mutex);
+	while(true)
+	{
+		// oldest pending block first
+		slot_t *slot = NULL;
+		for(unsigned i = pool->head; i != pool->tail; i++)
+		{
+			if(pool->slots[i % MAX_SLOTS].state == SLOT_PENDING)
+			{
+				slot = &pool->slots[i % MAX_SLOTS];
+				break;
+			}
+		}
+
+		if(!slot)
+		{
+			if(pool->quit)
+				break;
+
+			pthread_cond_wait(&pool->pending, &pool->mutex);
+			continue;
+		}
+
+		slot->state = SLOT_BUSY;
+		pthread_mutex_unlock(&pool->mutex);
+
+		slot->status = -1;
+		if(  valid
+			&& (deflateReset(&strm) == Z_OK)
+			&& (deflateParams(&strm, slot->level, Z_DEFAULT_STRATEGY) == Z_OK) )
+		{
+			strm.next_in = slot->buf;
+			strm.avail_in = slot->size;
+			strm.next_out = slot->out;
+			strm.avail_out = ZOUT_SIZE;
+
+			if(deflate(&strm, Z_FINISH) == Z_STREAM_END)
+			{
+				slot->out_size = ZOUT_SIZE - strm.avail_out;
+				slot->status = 0;
+			}
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		slot->state = SLOT_DONE;
+		pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	if(valid)
+		deflateEnd(&strm);
+
+	return NULL;
+}
+
+static inline void
+_pool_free(pool_t *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->pending);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for(unsigned i = 0; i < pool->nthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->pending);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+}
+
+static inline pool_t *
+_pool_new(void)
+{
+	pool_t *pool = calloc(1, sizeof(pool_t));
+	if(!pool)
+		return NULL;
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->pending, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	long ncpus = 2;
+#if defined(_SC_NPROCESSORS_ONLN)
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	// leave one core to the host
+	const unsigned nthreads = (ncpus > MAX_COMPRESSORS) ? MAX_COMPRESSORS
+		: (ncpus > 2) ? ncpus - 1
+		: 1;
+
+	for(unsigned i = 0; i < nthreads; i++)
+	{
+		if(pthread_create(&pool->threads[i], NULL, _pool_thread, pool) != 0)
+			break;
+
+		pool->nthreads += 1;
+	}
+
+	if(pool->nthreads == 0)
+	{
+		_pool_free(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+static inline int
+_slot_write(plughandle_t *handle, const slot_t *slot)
+{
+	if(slot->status != 0)
+	{
+		if(handle->log)
+			lv2_log_error(&handle->logger, "%s: deflate failed\n", __func__);
+		return -1;
+	}
+
+	if(write(handle->fd, slot->out, slot->out_size) != (ssize_t)slot->out_size)
+	{
+		if(handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: write failed: %s '%s'\n",
+				__func__, handle->file_path, strerror(errno));
+		}
+		return -1;
+	}
+
+	if( (_index_append(handle, slot->beats, handle->fd_offset, slot->count, slot->tracks,
+			slot->out_size) != 0)
+		&& handle->log)
+	{
+		lv2_log_error(&handle->logger, "%s: index overflow\n", __func__);
+	}
+
+	handle->fd_offset += slot->out_size;
+	handle->io.written += slot->out_size;
+	handle->io.compressed += slot->out_size;
+
+	return 0;
+}
+
+// write out compressed blocks in order, wait for all of them when syncing,
+// else only while no slot is free
+static inline int
+_pool_collect(plughandle_t *handle, bool sync)
+{
+	pool_t *pool = handle->pool;
+	int res = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while(pool->head != pool->tail)
+	{
+		slot_t *slot = &pool->slots[pool->head % MAX_SLOTS];
+
+		if(slot->state != SLOT_DONE)
+		{
+			if(!sync && (pool->tail - pool->head < MAX_SLOTS) )
+				break;
+
+			pthread_cond_wait(&pool->done, &pool->mutex);
+			continue;
+		}
+
+		pthread_mutex_unlock(&pool->mutex);
+		if(_slot_write(handle, slot) != 0)
+			res = -1;
+		pthread_mutex_lock(&pool->mutex);
+
+		slot->state = SLOT_FREE;
+		pool->head += 1;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return res;
+}
+
+// hand current block over to compression threads
+static inline int
+_pool_submit(plughandle_t *handle)
+{
+	pool_t *pool = handle->pool;
+
+	const int res = _pool_collect(handle, false); // makes room for at least one
+
+	slot_t *slot = &pool->slots[pool->tail % MAX_SLOTS]; // free, thus ours
+	slot->level = writing_levels[handle->compression];
+	slot->beats = handle->blk.beats;
+	slot->count = handle->blk.count;
+	slot->tracks = handle->blk.tracks;
+	slot->size = handle->blk.size;
+	memcpy(slot->buf, handle->blk.buf, handle->blk.size);
+
+	pthread_mutex_lock(&pool->mutex);
+	slot->state = SLOT_PENDING;
+	pool->tail += 1;
+	pthread_cond_signal(&pool->pending);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return res;
+}
+
+// reserve item in current block, returns destination of its body
+static inline uint8_t *
+_block_reserve(plughandle_t *handle, double beats, uint32_t size)
+{
+	if(handle->blk.size == 0)
+		handle->blk.beats = beats;
+
+	item_t itm = {
+		.beats.d = beats,
+		.size = size
+	};
+	itm.beats.u = htobe64(itm.beats.u);
+	itm.size = htobe32(itm.size);
+
+	uint8_t *dst = &handle->blk.buf[handle->blk.size];
+	memcpy(dst, &itm, sizeof(item_t));
+	handle->blk.size += sizeof(item_t) + ITEM_SIZE(size);
+
+	if(ITEM_IS_EVENT(size))
+	{
+		handle->blk.count += 1;
+		handle->blk.tracks |= 1U << ITEM_TRACK(size);
+		handle->stats.last = fmax(handle->stats.last, beats);
+	}
+
+	return dst + sizeof(item_t);
+}
+
+static inline void
+_block_append(plughandle_t *handle, double beats, uint32_t size, const void *body)
+{
+	memcpy(_block_reserve(handle, beats, size), body, ITEM_SIZE(size));
+}
+
+static inline int
+_block_flush(plughandle_t *handle)
+{
+	if(handle->blk.size == 0)
+		return 0;
+
+	handle->io.encoded += handle->blk.size;
+
+	if(handle->pool && !handle->raw)
+	{
+		const int res = _pool_submit(handle);
+
+		handle->blk.size = 0;
+		handle->blk.count = 0;
+		handle->blk.tracks = 0;
+
+		return res;
+	}
+
+	const uint64_t offset = handle->fd_offset;
+
+	if(_member_write(handle, handle->blk.buf, handle->blk.size) != 0)
+		return -1;
+	handle->io.compressed += handle->fd_offset - offset;
+
+	if( (_index_append(handle, handle->blk.beats, offset, handle->blk.count,
+			handle->blk.tracks, handle->fd_offset - offset) != 0)
+		&& handle->log)
+	{
+		lv2_log_error(&handle->logger, "%s: index overflow\n", __func__);
+	}
+
+	handle->blk.size = 0;
+	handle->blk.count = 0;
+	handle->blk.tracks = 0;
+
+	return 0;
+}
+
+// flush current block and wait for all blocks to be written out
+static inline int
+_block_sync(plughandle_t *handle)
+{
+	if(_block_flush(handle) != 0)
+		return -1;
+
+	if(handle->pool)
+		return _pool_collect(handle, true);
+
+	return 0;
+}
+
+static inline int
+_index_write(plughandle_t *handle)
+{
+	size_t dict_size = 0;
+	netatom_shared_rewind(handle->netatom);
+	if(_dict_pending(handle, &dict_size) != 0)
+		return -1;
+
+	const size_t tot_size = sizeof(item_t) + sizeof(uint32_t)
+		+ handle->index.n * sizeof(entry_t) + sizeof(uint32_t) + dict_size;
+	uint8_t *buf = malloc(tot_size);
+	if(!buf)
+		return -1;
+
+	// end-of-data marker, so sequential readers stop in front of the index
+	item_t *itm = (item_t *)buf;
+	itm->beats.u = 0;
+	itm->size = 0;
+
+	uint32_t *n = (uint32_t *)&itm[1];
+	*n = htobe32(handle->index.n);
+
+	entry_t *entries = (entry_t *)&n[1];
+	for(size_t i = 0; i < handle->index.n; i++)
+	{
+		const entry_t *src = &handle->index.entries[i];
+		entry_t *dst = &entries[i];
+
+		_double_to_be(&dst->beats, src->beats);
+		dst->offset = htobe64(src->offset);
+		dst->count = htobe32(src->count);
+		dst->tracks = htobe32(src->tracks);
+		dst->size = htobe32(src->size);
+	}
+
+	uint32_t *dict_n = (uint32_t *)&entries[handle->index.n];
+	*dict_n = htobe32(dict_size);
+	memcpy(&dict_n[1], handle->dict, dict_size);
+
+	const uint64_t offset = handle->fd_offset;
+	const int res = _member_write(handle, buf, tot_size);
+	free(buf);
+
+	if(res != 0)
+		return -1;
+
+	return _footer_write(handle, offset);
+}
+
+// flush recording and append checkpoint with blocks and dictionary entries
+// written since the previous one
+static inline int
+_checkpoint_write(plughandle_t *handle)
+{
+	if( (handle->fd == -1) || !handle->writing || handle->punch.active)
+		return 0; // chain covers original recording while punched in
+
+	if(_block_sync(handle) != 0)
+		return -1;
+
+	// pending dictionary has been consumed by blocks already, thus start over
+	size_t dict_size = 0;
+	netatom_shared_rewind(handle->netatom);
+	if(_dict_pending(handle, &dict_size) != 0)
+		return -1;
+
+	const uint8_t *dict = handle->dict + sizeof(uint32_t);
+	const uint8_t *end = dict_size ? handle->dict + dict_size : dict;
+	uint32_t ndict = 0;
+	for(const uint8_t *cur = dict; cur + sizeof(LV2_Atom) <= end; ndict++)
+	{
+		if(ndict == handle->checkpoint.dict) // skip entries covered already
+			dict = cur;
+
+		const LV2_Atom *atom = (const LV2_Atom *)cur;
+		cur += sizeof(LV2_Atom) + lv2_atom_pad_size(be32toh(atom->size));
+	}
+	if(ndict <= handle->checkpoint.dict)
+		dict = end;
+
+	if( (handle->index.n == handle->checkpoint.n) && (dict == end) )
+		return 0; // nothing new
+
+	uint8_t *buf = malloc(MAX_STORED);
+	if(!buf)
+		return -1;
+
+	uint64_t events = 0;
+	for(size_t i = 0; i < handle->checkpoint.n; i++)
+		events += handle->index.entries[i].count;
+
+	const uint64_t start = handle->fd_offset;
+	int res = 0;
+	do // split into several checkpoints if too big for a stored member
+	{
+		item_t *itm = (item_t *)buf;
+		checkpoint_t *chk = (checkpoint_t *)&itm[1];
+		entry_t *entries = (entry_t *)&chk[1];
+
+		const size_t dict_len = end - dict;
+		const size_t room = MAX_STORED - sizeof(item_t) - sizeof(checkpoint_t) - dict_len;
+		size_t n = handle->index.n - handle->checkpoint.n;
+		if(n > room / sizeof(entry_t))
+			n = room / sizeof(entry_t);
+
+		for(size_t i = 0; i < n; i++)
+		{
+			const entry_t *src = &handle->index.entries[handle->checkpoint.n + i];
+			entry_t *dst = &entries[i];
+
+			_double_to_be(&dst->beats, src->beats);
+			dst->offset = htobe64(src->offset);
+			dst->count = htobe32(src->count);
+			dst->tracks = htobe32(src->tracks);
+			dst->size = htobe32(src->size);
+			events += src->count;
+		}
+		memcpy(&entries[n], dict, dict_len);
+
+		// events of blocks not covered yet lie behind start of next block
+		const bool complete = handle->checkpoint.n + n == handle->index.n;
+		const double last = complete
+			? handle->stats.last
+			: handle->index.entries[handle->checkpoint.n + n].beats;
+
+		const uint32_t size = n * sizeof(entry_t) + dict_len;
+		itm->beats.u = 0;
+		itm->size = htobe32( (sizeof(checkpoint_t) + size) | ITEM_FLAG_META);
+		memcpy(chk->magic, checkpoint_magic, MAGIC_SIZE);
+		chk->version = htobe32(FORMAT_VERSION);
+		chk->size = htobe32(size);
+		chk->prev = htobe64(handle->checkpoint.offset);
+		chk->events = htobe64(events);
+		_double_to_be(&chk->first, handle->index.n ? handle->index.entries[0].beats : 0.0);
+		_double_to_be(&chk->last, events ? last : 0.0);
+		chk->n = htobe32(n);
+		chk->base = htobe32(handle->checkpoint.dict);
+		chk->crc = htobe32(_checkpoint_crc(chk, size));
+
+		const uint64_t offset = handle->fd_offset;
+		if(_stored_write(handle, buf, sizeof(item_t) + sizeof(checkpoint_t) + size) != 0)
+		{
+			res = -1;
+			break;
+		}
+
+		handle->checkpoint.offset = offset;
+		handle->checkpoint.n += n;
+		if(dict != end)
+			handle->checkpoint.dict = ndict;
+		dict = end;
+	} while(handle->checkpoint.n < handle->index.n);
+
+	free(buf);
+
+	// readers pass over checkpoints right behind a block without seeking
+	if( (res == 0) && handle->index.n)
+	{
+		entry_t *last = &handle->index.entries[handle->index.n - 1];
+
+		if(last->offset + last->size == start)
+			last->size += handle->fd_offset - start;
+	}
+
+	return res;
+}
+
+// read and validate checkpoint at given file offset of its magic
+static inline int
+_checkpoint_read(plughandle_t *handle, off_t pos, checkpoint_t *chk)
+{
+	if(pread(handle->fd, chk, sizeof(checkpoint_t), pos) != sizeof(checkpoint_t))
+		return -1;
+
+	const uint32_t version = be32toh(chk->version);
+	const uint32_t size = be32toh(chk->size);
+	if(  memcmp(chk->magic, checkpoint_magic, MAGIC_SIZE)
+		|| (version < 2) || (version > FORMAT_VERSION)
+		|| (size > MAX_STORED)
+		|| (pread(handle->fd, &chk[1], size, pos + sizeof(checkpoint_t)) != size)
+		|| (be32toh(chk->crc) != _checkpoint_crc(chk, size)) )
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+// rebuild index and dictionary of unfinalized recording from its chain of
+// checkpoints, the last one is found by scanning backwards from the end of
+// the file, anything behind it is lost
+static inline int
+_checkpoint_recover(plughandle_t *handle)
+{
+	uint8_t head [2];
+	const off_t size = lseek(handle->fd, 0, SEEK_END);
+	if(  (size < (off_t)sizeof(head))
+		|| (pread(handle->fd, head, sizeof(head), 0) != sizeof(head)) )
+		return -1;
+
+	// checkpoint payload follows stored gzip member header, if any, and item
+	const bool raw = (head[0] != 0x1f) || (head[1] != 0x8b);
+	const off_t skip = (raw ? 0 : GZIP_HEADER_SIZE) + sizeof(item_t);
+
+	uint8_t *scan = malloc(BLOCK_SIZE + MAGIC_SIZE + sizeof(checkpoint_t) + MAX_STORED);
+	if(!scan)
+		return -1;
+	checkpoint_t *chk = (checkpoint_t *)&scan[BLOCK_SIZE + MAGIC_SIZE];
+
+	off_t found = -1;
+	for(off_t end = size; (found == -1) && (end > 0); )
+	{
+		const off_t start = (end > BLOCK_SIZE) ? end - BLOCK_SIZE : 0;
+		const size_t len = ( (end + MAGIC_SIZE < size) ? end + MAGIC_SIZE : size) - start;
+		if(pread(handle->fd, scan, len, start) != (ssize_t)len)
+			break;
+
+		for(off_t i = end - start - 1; i >= 0; i--)
+		{
+			if(  (i + MAGIC_SIZE <= (off_t)len)
+				&& !memcmp(&scan[i], checkpoint_magic, MAGIC_SIZE)
+				&& (_checkpoint_read(handle, start + i, chk) == 0) )
+			{
+				found = start + i;
+				break;
+			}
+		}
+
+		end = start;
+	}
+
+	// walk chain back to first checkpoint
+	off_t *chain = NULL;
+	size_t n = 0;
+	for(off_t pos = found; pos != -1; )
+	{
+		off_t *_chain = realloc(chain, (n + 1) * sizeof(off_t));
+		if(!_chain)
+		{
+			found = -1;
+			break;
+		}
+		chain = _chain;
+		chain[n++] = pos;
+
+		const off_t prev = be64toh(chk->prev);
+		if(prev == 0)
+			break;
+
+		if( (prev + skip >= pos) || (_checkpoint_read(handle, prev + skip, chk) != 0) )
+		{
+			found = -1; // broken chain
+			break;
+		}
+		pos = prev + skip;
+	}
+
+	int res = (found == -1) ? -1 : 0;
+	_index_clear(handle);
+
+	// replay chain in order of writing
+	while( (res == 0) && n--)
+	{
+		if(_checkpoint_read(handle, chain[n], chk) != 0)
+		{
+			res = -1;
+			break;
+		}
+
+		const uint32_t m = be32toh(chk->n);
+		const size_t entry_size = _entry_size(be32toh(chk->version));
+		const uint8_t *entries = (const uint8_t *)&chk[1];
+		const size_t dict_len = be32toh(chk->size) - m * entry_size;
+		if(m * entry_size > be32toh(chk->size))
+		{
+			res = -1;
+			break;
+		}
+
+		for(uint32_t i = 0; (res == 0) && (i < m); i++)
+		{
+			entry_t entry = {
+				.size = 0
+			};
+			memcpy(&entry, &entries[i * entry_size], entry_size);
+
+			res = _index_append(handle, _double_from_be(&entry.beats), be64toh(entry.offset),
+				be32toh(entry.count), be32toh(entry.tracks), be32toh(entry.size));
+		}
+
+		if(  (res == 0) && dict_len
+			&& (netatom_shared_append(handle->netatom, be32toh(chk->base),
+				&entries[m * entry_size], dict_len) != 0) )
+		{
+			res = -1;
+		}
+	}
+
+	if(res == 0) // last checkpoint is still loaded
+	{
+		handle->stats.events = be64toh(chk->events);
+		handle->stats.first = _double_from_be(&chk->first);
+		handle->stats.last = _double_from_be(&chk->last);
+
+		_index_extents(handle, found - skip);
+		handle->fd_offset = found + sizeof(checkpoint_t) + be32toh(chk->size)
+			+ (raw ? 0 : GZIP_TRAILER_SIZE);
+		handle->checkpoint.offset = found - skip;
+		handle->checkpoint.n = handle->index.n;
+	}
+	else
+	{
+		_index_clear(handle);
+		netatom_shared_reset(handle->netatom);
+	}
+
+	free(chain);
+	free(scan);
+
+	return res;
+}
+
+// load single block of original recording, uncompressed, without moving the
+// file position takes are appended at
+static inline int
+_block_load(plughandle_t *handle, size_t i, size_t *size)
+{
+	const entry_t *entry = &handle->punch.entries[i];
+	uint64_t offset = entry->offset;
+	uint64_t len = entry->size;
+
+	if(handle->raw)
+	{
+		if(len > BLOCK_SIZE)
+			len = BLOCK_SIZE; // followed by checkpoint
+
+		if(pread(handle->fd, handle->punch.buf, len, offset) != (ssize_t)len)
+			return -1;
+
+		*size = len;
+		return 0;
+	}
+
+	z_stream strm;
+	memset(&strm, 0x0, sizeof(z_stream));
+	if(inflateInit2(&strm, 15 + 16) != Z_OK)
+		return -1;
+
+	strm.next_out = handle->punch.buf;
+	strm.avail_out = BLOCK_SIZE;
+
+	int res = Z_OK;
+	while( (res == Z_OK) && len)
+	{
+		const size_t chunk = (len < ZBUF_SIZE) ? len : ZBUF_SIZE;
+		if(pread(handle->fd, handle->zbuf, chunk, offset) != (ssize_t)chunk)
+			break;
+		offset += chunk;
+		len -= chunk;
+
+		strm.next_in = handle->zbuf;
+		strm.avail_in = chunk;
+
+		while( (res == Z_OK) && strm.avail_in)
+			res = inflate(&strm, Z_NO_FLUSH);
+	}
+
+	*size = BLOCK_SIZE - strm.avail_out;
+	inflateEnd(&strm);
+
+	return (res == Z_STREAM_END) ? 0 : -1;
+}
+
+// append items of loaded block within [from, until) to current block as-is
+static inline int
+_block_filter(plughandle_t *handle, size_t size, double from, double until)
+{
+	size_t offset = 0;
+
+	while(offset + sizeof(item_t) <= size)
+	{
+		const uint8_t *src = &handle->punch.buf[offset];
+
+		item_t itm;
+		memcpy(&itm, src, sizeof(item_t));
+		itm.beats.u = be64toh(itm.beats.u);
+		itm.size = be32toh(itm.size);
+
+		const size_t len = sizeof(item_t) + ITEM_SIZE(itm.size);
+		if(itm.size & ITEM_FLAG_META) // header or trailing checkpoint
+		{
+			offset += len;
+			continue;
+		}
+
+		if( (itm.size == 0) || (offset + len > size) )
+			return -1;
+
+		if( (itm.beats.d >= from) && (itm.beats.d < until) )
+		{
+			if( (handle->blk.size + len > BLOCK_SIZE) && (_block_flush(handle) != 0) )
+				return -1;
+
+			if(handle->blk.size == 0)
+				handle->blk.beats = itm.beats.d;
+
+			memcpy(&handle->blk.buf[handle->blk.size], src, len);
+			handle->blk.size += len;
+
+			if(ITEM_IS_EVENT(itm.size))
+			{
+				handle->blk.count += 1;
+				handle->blk.tracks |= 1U << ITEM_TRACK(itm.size);
+				handle->stats.last = fmax(handle->stats.last, itm.beats.d);
+			}
+		}
+
+		offset += len;
+	}
+
+	return 0;
+}
+
+// drop take, so that the original recording ends with its footer again, and
+// stop recording into it
+static inline void
+_punch_abort(plughandle_t *handle)
+{
+	if(handle->pool) // blocks still being compressed belong to the take
+		_pool_collect(handle, true);
+
+	if( (ftruncate(handle->fd, handle->punch.size) != 0) && handle->log)
+	{
+		lv2_log_error(&handle->logger, "%s: restoring failed: %s '%s'\n",
+			__func__, handle->file_path, strerror(errno));
+	}
+
+	free(handle->punch.entries);
+	handle->punch.entries = NULL;
+	handle->punch.n = 0;
+	handle->punch.active = false;
+
+	handle->blk.size = 0;
+	handle->blk.count = 0;
+	handle->blk.tracks = 0;
+
+	deflateEnd(&handle->strm);
+	handle->writing = false;
+}
+
+// end take with the remainder of the block it ends in, blocks behind that one
+// stay where they are, the new index refers to them and to the take alike
+static inline int
+_punch_merge(plughandle_t *handle)
+{
+	const double until = fmax(handle->punch.until, handle->punch.from);
+	const size_t j = _entries_find(handle->punch.entries, handle->punch.n, until);
+
+	// URIs of dropped items may still be referenced by the remainder
+	size_t dict_size;
+	if(_dict_pending(handle, &dict_size) != 0)
+		return -1;
+
+	if( (handle->blk.size + sizeof(item_t) + dict_size > BLOCK_SIZE)
+		&& (_block_flush(handle) != 0) )
+		return -1;
+
+	if(dict_size)
+		_block_append(handle, until, dict_size | ITEM_FLAG_DICT, handle->dict);
+
+	// salvage items of partially overwritten block
+	size_t size;
+	if(  (_block_load(handle, j, &size) != 0)
+		|| (_block_filter(handle, size, until, INFINITY) != 0)
+		|| (_block_sync(handle) != 0) )
+		return -1;
+
+	for(size_t i = j + 1; i < handle->punch.n; i++)
+	{
+		const entry_t *entry = &handle->punch.entries[i];
+
+		if(_index_append(handle, entry->beats, entry->offset, entry->count, entry->tracks,
+			entry->size) != 0)
+			return -1;
+	}
+
+	// last event of original recording, unless it has been punched over
+	if( (handle->punch.last < handle->punch.from) || (handle->punch.last >= until) )
+		handle->stats.last = fmax(handle->stats.last, handle->punch.last);
+
+	return _index_write(handle);
+}
+
+// take neither holds nor overwrites anything, e.g. when relocating right
+// after punch in, thus original recording is restored as is
+static inline int
+_punch_discard(plughandle_t *handle)
+{
+	if(handle->pool)
+		_pool_collect(handle, true);
+
+	if(ftruncate(handle->fd, handle->punch.size) != 0)
+		return -1;
+
+	memcpy(handle->index.entries, handle->punch.entries,
+		handle->punch.n * sizeof(entry_t));
+	handle->index.n = handle->punch.n;
+	handle->fd_offset = handle->punch.size;
+	handle->stats.last = handle->punch.last;
+	memset(&handle->checkpoint, 0x0, sizeof(handle->checkpoint));
+
+	handle->blk.size = 0;
+	handle->blk.count = 0;
+	handle->blk.tracks = 0;
+
+	return 0;
+}
+
+// end current take and finalize recording, a take punched into an existing
+// recording is dropped on failure
+static inline int
+_punch_out(plughandle_t *handle)
+{
+	if(!handle->punch.active)
+		return (_block_sync(handle) == 0) ? _index_write(handle) : -1;
+
+	const bool empty = !handle->punch.recorded
+		&& (handle->punch.until <= handle->punch.from);
+
+	if( (!empty || (_punch_discard(handle) != 0))
+		&& (_punch_merge(handle) != 0) )
+	{
+		_punch_abort(handle);
+		return -1;
+	}
+
+	free(handle->punch.entries);
+	handle->punch.entries = NULL;
+	handle->punch.n = 0;
+	handle->punch.active = false;
+
+	return 0;
+}
+
+static inline void
+_close_disk(plughandle_t *handle)
+{
+	if(handle->gzfile)
+	{
+		gzclose(handle->gzfile);
+		handle->gzfile = NULL;
+	}
+
+	if(handle->mapped.base)
+	{
+#if !defined(_WIN32)
+		munmap(handle->mapped.base, handle->mapped.size);
+#endif
+		free(handle->mapped.converted);
+		memset(&handle->mapped, 0x0, sizeof(handle->mapped));
+	}
+
+	if(handle->fd != -1)
+	{
+		if(handle->writing && (_punch_out(handle) != 0) && handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: finalizing failed: %s '%s'\n",
+				__func__, handle->file_path, strerror(errno));
+		}
+
+		if(handle->writing) // else take has been dropped
+			deflateEnd(&handle->strm);
+
+		close(handle->fd);
+		handle->fd = -1;
+	}
+
+	handle->writing = false;
+	handle->peeking = false;
+	netatom_shared_reset(handle->netatom);
+}
+
+// restart decompression at start of block
+static inline int
+_seek_offset(plughandle_t *handle, off_t offset)
+{
+	if(handle->gzfile)
+	{
+		gzclose(handle->gzfile);
+		handle->gzfile = NULL;
+	}
+
+	handle->peeking = false;
+	handle->last = -INFINITY;
+
+	if(lseek(handle->fd, offset, SEEK_SET) == -1)
+		return -1;
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+	// streaming onwards from here, have the kernel read ahead eagerly
+	posix_fadvise(handle->fd, offset, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	handle->gzfile = gzdopen(dup(handle->fd), reading_mode);
+	if(!handle->gzfile)
+	{
+		if(handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: gzdopen failed: %s '%s'\n",
+				__func__, handle->file_path, strerror(errno));
+		}
+		return -1;
+	}
+
+	// fewer, larger reads per read-ahead
+	gzbuffer(handle->gzfile, GZ_BUFFER_SIZE);
+
+	return 0;
+}
+
+// restart decompression at start of given block of index
+static inline int
+_seek_block(plughandle_t *handle, size_t blk)
+{
+	handle->cursor.blk = blk;
+	handle->cursor.left = handle->index.entries[blk].count;
+
+	return _seek_offset(handle, handle->index.entries[blk].offset);
+}
+
+// current block has been streamed, continue with next one holding events,
+// wherever it lies in the file
+static inline int
+_cursor_next(plughandle_t *handle)
+{
+	const entry_t *entries = handle->index.entries;
+	const size_t n = handle->index.n;
+	size_t k = handle->cursor.blk;
+	bool detached = false;
+
+	if(k >= n)
+		return 0; // behind last block, e.g. unindexed remainder
+
+	do
+	{
+		k += 1;
+		detached = detached || ( (k < n) && _entry_detached(entries, k) );
+	} while( (k < n) && (entries[k].count == 0) );
+
+	if( (k < n) && detached)
+		return _seek_block(handle, k);
+
+	handle->cursor.blk = k;
+	handle->cursor.left = (k < n) ? entries[k].count : 0;
+
+	return 0;
+}
+
+static inline int
+_read_header(plughandle_t *handle, double *beats, uint32_t *size)
+{
+	if(!handle->peeking)
+	{
+		if( (handle->cursor.left == 0) && (_cursor_next(handle) != 0) )
+			return -1;
+
+		if(gzfread(&handle->itm, sizeof(item_t), 1, handle->gzfile) != 1)
+		{
+			int errnum;
+			const char *err = gzerror(handle->gzfile, &errnum);
+			if( (errnum != Z_OK) && handle->log)
+			{
+				lv2_log_error(&handle->logger, "%s: gzfread failed: %s\n", __func__, err);
+			}
+			return -1;
+		}
+
+		handle->itm.beats.u = be64toh(handle->itm.beats.u);
+		handle->itm.size = be32toh(handle->itm.size);
+		handle->peeking = true;
+	}
+
+	if(handle->itm.size == 0) // end-of-data marker
+		return -1;
+
+	if(beats)
+		*beats = handle->itm.beats.d;
+	if(size)
+		*size = handle->itm.size;
+
+	return 0;
+}
+
+static inline void
+_consume_header(plughandle_t *handle)
+{
+	handle->peeking = false;
+	handle->last = handle->itm.beats.d;
+
+	if(ITEM_IS_EVENT(handle->itm.size) && handle->cursor.left)
+		handle->cursor.left -= 1;
+}
+
+static inline int
+_skip_to(plughandle_t *handle, double beats)
+{
+	double _beats;
+	uint32_t _size;
+	while(_read_header(handle, &_beats, &_size) == 0)
+	{
+		if(_beats >= beats) // found point of interest
+			break;
+
+		_consume_header(handle);
+
+		if(_size & ITEM_FLAG_DICT) // dictionary entries cannot be skipped
+		{
+			if(_dict_load(handle, handle->gzfile, ITEM_SIZE(_size)) != 0)
+			{
+				if(handle->log)
+					lv2_log_error(&handle->logger, "%s: invalid dictionary\n", __func__);
+				return -1;
+			}
+		}
+		else if(gzseek(handle->gzfile, ITEM_SIZE(_size), SEEK_CUR) == -1) // skip item payload
+		{
+			if(handle->log)
+			{
+				lv2_log_error(&handle->logger, "%s: gzseek failed: %s '%s'\n",
+					__func__, handle->file_path, strerror(errno));
+			}
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static inline int
+_item_peek(plughandle_t *handle, size_t offset, double *beats, uint32_t *flags)
+{
+	if(offset + sizeof(item_t) > handle->mapped.size)
+		return -1;
+
+	item_t itm;
+	memcpy(&itm, handle->mapped.base + offset, sizeof(item_t));
+	itm.beats.u = be64toh(itm.beats.u);
+	itm.size = be32toh(itm.size);
+
+	if( (itm.size == 0) // end-of-data marker
+		|| (offset + sizeof(item_t) + ITEM_SIZE(itm.size) > handle->mapped.size) )
+		return -1;
+
+	if(beats)
+		*beats = itm.beats.d;
+	*flags = itm.size;
+
+	return 0;
+}
+
+// build index and dictionary of unfinalized recording by walking its items
+static inline int
+_map_scan(plughandle_t *handle)
+{
+	size_t offset = 0;
+	double beats;
+	uint32_t flags;
+
+	while(_item_peek(handle, offset, &beats, &flags) == 0)
+	{
+		const uint8_t *body = handle->mapped.base + offset + sizeof(item_t);
+
+		if( (flags & ITEM_FLAG_DICT) && (_dict_parse(handle->netatom, body, ITEM_SIZE(flags)) != 0) )
+			return -1;
+
+		if(  (handle->index.n == 0)
+			|| (offset >= handle->index.entries[handle->index.n - 1].offset + BLOCK_SIZE) )
+		{
+			if(_index_append(handle, beats, offset, 0, 0, 0) != 0)
+				return -1;
+		}
+
+		if(ITEM_IS_EVENT(flags))
+		{
+			if(handle->stats.events == 0)
+				handle->stats.first = beats;
+			handle->stats.last = beats;
+			handle->stats.events += 1;
+			handle->index.entries[handle->index.n - 1].count += 1;
+			handle->index.entries[handle->index.n - 1].tracks |= 1U << ITEM_TRACK(flags);
+		}
+
+		offset += sizeof(item_t) + ITEM_SIZE(flags);
+	}
+	_index_extents(handle, offset);
+
+	return 0;
+}
+
+// convert items of given block to host URIDs and byte order in place, once
+static inline void
+_map_convert(plughandle_t *handle, size_t blk)
+{
+	if(handle->mapped.converted[blk])
+		return;
+
+	handle->mapped.converted[blk] = 1;
+
+	const entry_t *entry = &handle->index.entries[blk];
+	const size_t end = (entry->offset + entry->size < handle->mapped.size)
+		? entry->offset + entry->size
+		: handle->mapped.size;
+	uint32_t flags;
+
+	for(size_t offset = handle->index.entries[blk].offset;
+		(offset < end) && (_item_peek(handle, offset, NULL, &flags) == 0);
+		offset += sizeof(item_t) + ITEM_SIZE(flags))
+	{
+		if(!ITEM_IS_EVENT(flags))
+			continue;
+
+		uint8_t *body = handle->mapped.base + offset + sizeof(item_t);
+		LV2_Atom *atom = (LV2_Atom *)body;
+
+		const LV2_Atom *res = (flags & ITEM_FLAG_SHARED)
+			? netatom_deserialize_shared(handle->netatom, body, ITEM_SIZE(flags))
+			: netatom_deserialize(handle->netatom, body, ITEM_SIZE(flags));
+
+		if(!res)
+		{
+			atom->type = 0; // mark as invalid
+			if(handle->log)
+				lv2_log_error(&handle->logger, "%s: netatom_deserialize failed\n", __func__);
+		}
+	}
+}
+
+// move on to next block in order of index once current one has been read,
+// wherever it lies in the file, and convert it ahead of the play head
+static inline void
+_map_next(plughandle_t *handle)
+{
+	const entry_t *entries = handle->index.entries;
+	const size_t n = handle->index.n;
+	if(n == 0)
+		return;
+
+	while( (handle->mapped.blk + 1 < n)
+		&& (handle->mapped.cur >= entries[handle->mapped.blk].offset
+			+ entries[handle->mapped.blk].size) )
+	{
+		handle->mapped.blk += 1;
+
+		if(_entry_detached(entries, handle->mapped.blk))
+			handle->mapped.cur = entries[handle->mapped.blk].offset;
+	}
+
+	_map_convert(handle, handle->mapped.blk);
+}
+
+// map uncompressed recording into memory for zero-copy playback
+static inline int
+_map_disk(plughandle_t *handle)
+{
+#if defined(_WIN32)
+	return -1; // fall back to streaming
+#else
+	uint8_t head [2];
+	const off_t size = lseek(handle->fd, 0, SEEK_END);
+	if(  (size < (off_t)sizeof(item_t))
+		|| (lseek(handle->fd, 0, SEEK_SET) == -1)
+		|| (read(handle->fd, head, sizeof(head)) != sizeof(head))
+		|| ( (head[0] == 0x1f) && (head[1] == 0x8b) ) ) // is compressed
+	{
+		return -1;
+	}
+
+	// private mapping, as items are converted in place
+	uint8_t *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		handle->fd, 0);
+	if(base == MAP_FAILED)
+	{
+		if(handle->log)
+		{
+			lv2_log_note(&handle->logger, "%s: mmap failed: %s '%s'\n",
+				__func__, handle->file_path, strerror(errno));
+		}
+		return -1;
+	}
+
+#if defined(MADV_SEQUENTIAL)
+	madvise(base, size, MADV_SEQUENTIAL);
+#endif
+
+	handle->mapped.base = base;
+	handle->mapped.size = size;
+	handle->mapped.cur = 0;
+	handle->mapped.blk = 0;
+
+	if( (handle->index.n == 0) && (_map_scan(handle) != 0) && handle->log)
+	{
+		lv2_log_error(&handle->logger, "%s: scanning failed: '%s'\n",
+			__func__, handle->file_path);
+	}
+
+	handle->mapped.converted = calloc(handle->index.n + 1, sizeof(uint8_t));
+	if(!handle->mapped.converted)
+	{
+		munmap(handle->mapped.base, handle->mapped.size);
+		memset(&handle->mapped, 0x0, sizeof(handle->mapped));
+		return -1;
+	}
+
+	return 0;
+#endif
+}
+
+static inline int
+_map_seek(plughandle_t *handle, double beats)
+{
+	if(handle->index.n == 0) // empty recording
+		return 0;
+
+	handle->mapped.blk = _index_find(handle, beats);
+	handle->mapped.cur = handle->index.entries[handle->mapped.blk].offset;
+
+	double _beats;
+	uint32_t flags;
+	for(_map_next(handle);
+		(_item_peek(handle, handle->mapped.cur, &_beats, &flags) == 0) && (_beats < beats);
+		_map_next(handle))
+	{
+		handle->mapped.cur += sizeof(item_t) + ITEM_SIZE(flags);
+	}
+
+	return 0;
+}
+
+static inline int
+_seek_disk(plughandle_t *handle, double beats)
+{
+	if(handle->mapped.base)
+		return _map_seek(handle, beats);
+
+	if(handle->index.n)
+	{
+		if(_seek_block(handle, _index_find(handle, beats)) != 0)
+			return -1;
+	}
+	else if(handle->gzfile && (handle->last < beats) )
+	{
+		return _skip_to(handle, beats); // no index, but can continue forward from here
+	}
+	else if(_seek_offset(handle, 0) != 0)
+	{
+		return -1;
+	}
+
+	return _skip_to(handle, beats);
+}
+
+static inline bool
+_muted(plughandle_t *handle, uint32_t flags)
+{
+	return ITEM_IS_EVENT(flags) && (handle->muted & (1U << ITEM_TRACK(flags)));
+}
+
+// jump over blocks with events of muted tracks only, without decoding them,
+// given beats of a muted item, returns 1 if jumped, -1 at end of recording
+static inline int
+_skip_muted(plughandle_t *handle, double beats)
+{
+	const entry_t *entries = handle->index.entries;
+	const size_t n = handle->index.n;
+	if(n == 0)
+		return 0;
+
+	const size_t i = _index_find(handle, beats);
+	size_t k;
+	for(k = i; (k < n) && !(entries[k].tracks & ~handle->muted); k++)
+	{
+		// muted
+	}
+
+	if(k == n)
+		return -1; // remainder is muted
+
+	if( (k == i) || (entries[k].beats <= beats) )
+		return 0; // item may be followed by unmuted ones in same block
+
+	if(handle->mapped.base)
+	{
+		handle->mapped.blk = k;
+		handle->mapped.cur = entries[k].offset;
+
+		return 1;
+	}
+
+	// complete dictionary has been loaded with index
+	return (_seek_block(handle, k) == 0) ? 1 : -1;
+}
+
+static inline bool
+_looping(plughandle_t *handle)
+{
+	return handle->loop.end > handle->loop.start;
+}
+
+// item beyond loop region, stream wraps to loop start
+static inline bool
+_loop_end(plughandle_t *handle, double beats)
+{
+	return _looping(handle) && (beats >= handle->loop.end);
+}
+
+// adopt loop region and muted tracks for next reposition and find lap of
+// given beats
+static inline void
+_loop_set(plughandle_t *handle, const job_t *job)
+{
+	handle->muted = job->muted;
+	handle->loop.start = job->loop.start;
+	handle->loop.end = job->loop.end;
+	handle->loop.shift = _loop_shift(job->loop.start, job->loop.end, job->beats);
+}
+
+static inline int
+_map_read(plughandle_t *handle, double *beats, size_t *size)
+{
+	_map_next(handle);
+
+	uint32_t flags;
+	if(_item_peek(handle, handle->mapped.cur, beats, &flags) != 0)
+		return -1;
+
+	if(_loop_end(handle, *beats))
+		return 2;
+
+	if(_muted(handle, flags))
+	{
+		const int res = _skip_muted(handle, *beats);
+		if(res == 0)
+			handle->mapped.cur += sizeof(item_t) + ITEM_SIZE(flags);
+
+		return (res < 0) ? -1 : 0;
+	}
+	*beats += handle->loop.shift;
+
+	const LV2_Atom *atom = (const LV2_Atom *)(handle->mapped.base + handle->mapped.cur
+		+ sizeof(item_t));
+
+	if(ITEM_IS_EVENT(flags) && atom->type)
+	{
+		job_t *job;
+		if(!(job = varchunk_write_request(handle->to_dsp, sizeof(job_t))))
+			return 1; // full, retry with next read-ahead
+
+		job->type = TC_JOB_MAPPED;
+		job->beats = *beats;
+		job->ref = atom;
+
+		varchunk_write_advance(handle->to_dsp, sizeof(job_t));
+		*size = sizeof(job_t);
+	}
+
+	handle->mapped.cur += sizeof(item_t) + ITEM_SIZE(flags);
+
+	return 0;
+}
+
+// whether recording holds no events, e.g. a new file or an empty take
+static inline bool
+_disk_empty(plughandle_t *handle)
+{
+	if(lseek(handle->fd, 0, SEEK_SET) == -1)
+		return false;
+
+	gzFile gzfile = gzdopen(dup(handle->fd), reading_mode);
+	if(!gzfile)
+		return false;
+
+	bool empty = true;
+	item_t itm;
+	while(gzfread(&itm, sizeof(item_t), 1, gzfile) == 1)
+	{
+		const uint32_t flags = be32toh(itm.size);
+
+		if(flags == 0) // end-of-data marker
+			break;
+
+		if(ITEM_IS_EVENT(flags) || (gzseek(gzfile, ITEM_SIZE(flags), SEEK_CUR) == -1) )
+		{
+			empty = false;
+			break;
+		}
+	}
+
+	int errnum;
+	gzerror(gzfile, &errnum);
+	if(errnum != Z_OK) // rather keep what cannot be decoded
+		empty = false;
+	gzclose(gzfile);
+
+	return empty;
+}
+
+// punch in, takes are appended behind the original recording, which stays
+// untouched up to its footer until punch out
+static inline int
+_punch_disk(plughandle_t *handle, double beats)
+{
+	handle->blk.size = 0;
+	handle->blk.count = 0;
+	handle->blk.tracks = 0;
+
+	if(handle->index.n == 0)
+	{
+		// takes could not be referenced from an index
+		if(!_disk_empty(handle))
+		{
+			if(handle->log)
+			{
+				lv2_log_error(&handle->logger, "%s: no seek index to punch into: '%s'\n",
+					__func__, handle->file_path);
+			}
+
+			deflateEnd(&handle->strm);
+			handle->writing = false;
+			errno = ENOTSUP;
+			return -1;
+		}
+
+		// nothing to keep, start from scratch
+		_index_clear(handle);
+		memset(&handle->checkpoint, 0x0, sizeof(handle->checkpoint));
+		netatom_shared_reset(handle->netatom);
+		handle->stats.last = -INFINITY;
+
+		if(  (ftruncate(handle->fd, 0) != 0)
+			|| (lseek(handle->fd, 0, SEEK_SET) == -1) )
+		{
+			return -1;
+		}
+
+		handle->fd_offset = 0;
+
+		return _header_write(handle);
+	}
+
+	// stick to format of existing recording, e.g. gzip or raw
+	uint8_t head [2];
+	if(pread(handle->fd, head, sizeof(head), 0) != sizeof(head))
+		return -1;
+	handle->raw = (head[0] != 0x1f) || (head[1] != 0x8b);
+
+	const off_t size = lseek(handle->fd, 0, SEEK_END);
+	if(size == -1)
+		return -1;
+
+	const size_t entries_size = handle->index.n * sizeof(entry_t);
+	handle->punch.entries = malloc(entries_size);
+	if(!handle->punch.entries)
+		return -1;
+	memcpy(handle->punch.entries, handle->index.entries, entries_size);
+
+	handle->punch.n = handle->index.n;
+	handle->punch.size = size;
+	handle->fd_offset = size;
+
+	// original recording can be recovered from a chain of its own, should we
+	// not make it to punch out
+	memset(&handle->checkpoint, 0x0, sizeof(handle->checkpoint));
+	if(_checkpoint_write(handle) != 0)
+	{
+		_punch_abort(handle);
+		return -1;
+	}
+
+	const size_t i = _index_find(handle, beats);
+
+	handle->punch.active = true;
+	handle->punch.recorded = false;
+	handle->punch.from = beats;
+	handle->punch.until = beats;
+	handle->punch.last = handle->stats.last;
+	handle->stats.last = -INFINITY;
+	handle->index.n = i;
+
+	// salvage items of partially overwritten block
+	size_t len;
+	if(  (_block_load(handle, i, &len) != 0)
+		|| (_block_filter(handle, len, -INFINITY, beats) != 0) )
+	{
+		_punch_abort(handle);
+		return -1;
+	}
+
+	// dictionary of dropped items may be needed, thus repeat it all
+	netatom_shared_rewind(handle->netatom);
+
+	return 0;
+}
+
+static inline void
+_reopen_disk(plughandle_t *handle, bool writing, double beats)
+{
+	if( (handle->fd != -1) && (writing == handle->writing) )
+	{
+		// reuse already opened file and its index
+		const int res = writing
+			? ( (_punch_out(handle) == 0) ? _punch_disk(handle, beats) : -1 )
+			: _seek_disk(handle, beats);
+
+		if( (res != 0) && handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: repositioning failed: %s '%s'\n",
+				__func__, handle->file_path, strerror(errno));
+		}
+
+		return;
+	}
+
+	_close_disk(handle);
+
+	memset(&handle->stats, 0x0, sizeof(stats_t));
+	handle->report = !writing;
+
+	handle->fd = writing
+		? open(handle->file_path, O_RDWR | O_CREAT | O_BINARY, 0644)
+		: open(handle->file_path, O_RDONLY | O_BINARY);
+	if(handle->fd == -1)
+	{
+		if(handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: open failed: %s '%s'\n",
+				__func__, handle->file_path, strerror(errno));
+		}
+		return;
+	}
+
+	if(_header_load(handle) != 0) // refuse to touch unknown formats
+	{
+		memset(&handle->stats, 0x0, sizeof(stats_t));
+		close(handle->fd);
+		handle->fd = -1;
+		return;
+	}
+
+	if(_index_load(handle) != 0)
+	{
+		if(_checkpoint_recover(handle) == 0)
+		{
+			if(handle->log)
+			{
+				lv2_log_note(&handle->logger, "%s: recovered %zu blocks from checkpoints: '%s'\n",
+					__func__, handle->index.n, handle->file_path);
+			}
+		}
+		else if(handle->log)
+		{
+			lv2_log_note(&handle->logger, "%s: no seek index found: '%s'\n",
+				__func__, handle->file_path);
+		}
+	}
+
+	if(writing)
+	{
+		// stored deflate blocks in case we need to append to a gzip file
+		handle->raw = (handle->compression == TC_COMPRESSION_NONE);
+		if(deflateInit2(&handle->strm, writing_levels[handle->compression],
+			Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			if(handle->log)
+				lv2_log_error(&handle->logger, "%s: deflateInit2 failed\n", __func__);
+			close(handle->fd);
+			handle->fd = -1;
+			return;
+		}
+
+		handle->writing = true;
+
+		if( (_punch_disk(handle, beats) != 0) && handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: punching failed: %s '%s'\n",
+				__func__, handle->file_path, strerror(errno));
+		}
+
+		// spawn compression threads on first use, else deflate on the worker
+		if(!handle->pool && !handle->raw)
+		{
+			handle->pool = _pool_new();
+			if(!handle->pool && handle->log)
+			{
+				lv2_log_note(&handle->logger, "%s: no compression threads available\n",
+					__func__);
+			}
+		}
+	}
+	else
+	{
+		handle->gzfile = NULL;
+		if( (_map_disk(handle) != 0) && handle->log)
+		{
+			lv2_log_note(&handle->logger, "%s: streaming from disk: '%s'\n",
+				__func__, handle->file_path);
+		}
 
-		if( (written != 2) && handle->log)
+		if( (_seek_disk(handle, beats) != 0) && handle->log)
 		{
-			int errnum;
-			const char *err = gzerror(handle->gzfile, &errnum);
-			lv2_log_error(&handle->logger, "%s: gsfwrite failed: %s\n", __func__, err);
+			lv2_log_error(&handle->logger, "%s: seeking failed: %s '%s'\n",
+				__func__, handle->file_path, strerror(errno));
 		}
+	}
+}
 
-		return 0;
+static inline int
+_write_to(plughandle_t *handle, double beats, uint32_t track, const LV2_Atom *atom)
+{
+	//printf("_write\n");
+	if( (handle->fd == -1) || !handle->writing)
+		return -1;
+
+	handle->punch.until = fmax(handle->punch.until, beats);
+	handle->punch.recorded = true;
+
+	// only register referenced URIs on this pass, as newly referenced ones
+	// precede the item in the same block
+	size_t rx_size;
+	if(netatom_serialize_shared_sink(handle->netatom, atom, NULL, NULL, &rx_size) != 0)
+	{
+		if(handle->log)
+			lv2_log_error(&handle->logger, "%s: netatom_serialize failed\n", __func__);
+		return -1;
 	}
-	else if(handle->log)
+
+	size_t dict_size;
+	if(_dict_pending(handle, &dict_size) != 0)
 	{
-		lv2_log_error(&handle->logger, "%s: netatom_serialize failed\n", __func__);
+		if(handle->log)
+			lv2_log_error(&handle->logger, "%s: dictionary overflow\n", __func__);
+		return -1;
 	}
 
-	return -1;
+	const size_t tot_size = sizeof(item_t) + rx_size
+		+ (dict_size ? sizeof(item_t) + dict_size : 0);
+
+	if(tot_size > BLOCK_SIZE)
+	{
+		if(handle->log)
+			lv2_log_error(&handle->logger, "%s: event exceeds block size\n", __func__);
+		return -1;
+	}
+
+	if( (handle->blk.size + tot_size > BLOCK_SIZE) && (_block_flush(handle) != 0) )
+	{
+		if(handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: block flush failed: %s\n", __func__,
+				strerror(errno));
+		}
+	}
+
+	if(dict_size)
+		_block_append(handle, beats, dict_size | ITEM_FLAG_DICT, handle->dict);
+
+	// serialize straight into block
+	uint8_t *dst = _block_reserve(handle, beats,
+		rx_size | ITEM_FLAG_SHARED | ITEM_FLAG_TRACK(track));
+	netatom_serialize_shared_into(handle->netatom, atom, dst, rx_size, NULL);
+
+	return 0;
 }
 
 static inline int
-_read_from(plughandle_t *handle)
+_read_from(plughandle_t *handle, double *beats, size_t *size)
 {
 	//printf("_read\n");
+	if(handle->mapped.base)
+		return _map_read(handle, beats, size);
+
 	if(!handle->gzfile)
 		return -1;
 
-	double beats;
-	uint32_t tx_size;
-	if(_read_header(handle, &beats, &tx_size) != 0)
+	uint32_t flags;
+	if(_read_header(handle, beats, &flags) != 0)
 		return -1;
 
+	if(_loop_end(handle, *beats))
+		return 2; // header stays peeked
+
+	const uint32_t tx_size = ITEM_SIZE(flags);
+
+	if(_muted(handle, flags))
+	{
+		const int res = _skip_muted(handle, *beats);
+		if(res != 0)
+			return (res < 0) ? -1 : 0;
+
+		_consume_header(handle);
+
+		return (gzseek(handle->gzfile, tx_size, SEEK_CUR) == -1) ? -1 : 0;
+	}
+	*beats += handle->loop.shift;
+
+	if(flags & ITEM_FLAG_DICT)
+	{
+		_consume_header(handle);
+
+		if(_dict_load(handle, handle->gzfile, tx_size) != 0)
+		{
+			if(handle->log)
+				lv2_log_error(&handle->logger, "%s: invalid dictionary\n", __func__);
+			return -1;
+		}
+
+		return 0;
+	}
+	else if(flags & ITEM_FLAG_META)
+	{
+		_consume_header(handle);
+
+		return (gzseek(handle->gzfile, tx_size, SEEK_CUR) == -1) ? -1 : 0;
+	}
+
 	job_t *job;
 	const uint32_t tot_size = sizeof(job_t) + tx_size;
 	if((job = varchunk_write_request(handle->to_dsp, tot_size)))
 	{
-		job->type = TC_JOB_WRITE;
-		job->beats = beats;
+		_consume_header(handle);
+
+		job->type = TC_JOB_WRITE;
+		job->beats = *beats;
+
+		if(gzfread(job->atom, tx_size, 1, handle->gzfile) != 1)
+		{
+			int errnum;
+			const char *err = gzerror(handle->gzfile, &errnum);
+			if( (errnum != Z_OK) && handle->log)
+			{
+				lv2_log_error(&handle->logger, "%s: gzfread failed: %s\n", __func__, err);
+			}
+			return -1;
+		}
+
+		// items without shared flag carry their own dictionary
+		const LV2_Atom *atom = (flags & ITEM_FLAG_SHARED)
+			? netatom_deserialize_shared(handle->netatom, (uint8_t *)job->atom, tx_size)
+			: netatom_deserialize(handle->netatom, (uint8_t *)job->atom, tx_size);
+		if(atom)
+		{
+			const uint32_t atom_size = lv2_atom_total_size(atom);
+			memcpy(job->atom, atom, atom_size);
+
+			varchunk_write_advance(handle->to_dsp, sizeof(job_t) + atom_size);
+			*size = sizeof(job_t) + atom_size;
+			return 0;
+		}
+		else if(handle->log)
+		{
+			lv2_log_error(&handle->logger, "%s: netatom_deserialize failed\n", __func__);
+		}
+
+		return -1;
+	}
+
+	return 1; // full, header stays peeked for next read-ahead
+}
+
+// stream until given beat or byte budget is exhausted, returns horizon reached
+static inline double
+_read_ahead(plughandle_t *handle, double until)
+{
+	double horizon = -INFINITY;
+	size_t budget = 0;
+	bool lapped = false;
+
+	while(budget < READ_BUDGET)
+	{
+		double beats;
+		size_t size = 0;
+
+		const int status = _read_from(handle, &beats, &size);
+		if( (status == 2) || ( (status < 0) && _looping(handle) ) )
+		{
+			// continue at loop start ahead of time, shifted by one lap, skip
+			// over empty laps at once
+			const double len = handle->loop.end - handle->loop.start;
+			const double laps = lapped
+				? fmax(1.0, ceil( (until - handle->loop.shift - handle->loop.end) / len) )
+				: 1.0;
+
+			handle->loop.shift += laps * len;
+			lapped = true;
+			if(_seek_disk(handle, handle->loop.start) != 0)
+				return INFINITY;
+
+			horizon = handle->loop.shift + handle->loop.start;
+			if(horizon >= until)
+				break;
+
+			continue;
+		}
+		else if(status < 0)
+			return INFINITY; // end of recording, nothing more to request
+		else if(status > 0)
+			break;
+
+		lapped = false;
+		if(!size)
+			continue; // dictionary or meta item
+
+		horizon = beats;
+		budget += size;
+		handle->io.read += size;
+
+		if(beats >= until)
+			break;
+	}
+
+	return horizon;
+}
+
+// fetch next atom, either from memory mapping or from decompression buffer
+static inline int
+_fetch(plughandle_t *handle, double *beats, uint32_t *track, const LV2_Atom **atom)
+{
+	uint32_t flags;
+
+	if(handle->mapped.base)
+	{
+		for(_map_next(handle);
+			_item_peek(handle, handle->mapped.cur, beats, &flags) == 0;
+			_map_next(handle))
+		{
+			*atom = (const LV2_Atom *)(handle->mapped.base + handle->mapped.cur
+				+ sizeof(item_t));
+			*track = ITEM_TRACK(flags);
+			handle->mapped.cur += sizeof(item_t) + ITEM_SIZE(flags);
+
+			if(ITEM_IS_EVENT(flags) && (*atom)->type)
+				return 0;
+		}
+
+		return -1;
+	}
+
+	if(!handle->gzfile)
+		return -1;
+
+	while(_read_header(handle, beats, &flags) == 0)
+	{
+		const uint32_t size = ITEM_SIZE(flags);
+
+		_consume_header(handle);
+
+		if(flags & ITEM_FLAG_DICT)
+		{
+			if(_dict_load(handle, handle->gzfile, size) != 0)
+				return -1;
+			continue;
+		}
+		else if(flags & ITEM_FLAG_META)
+		{
+			if(gzseek(handle->gzfile, size, SEEK_CUR) == -1)
+				return -1;
+			continue;
+		}
+
+		if( (size > sizeof(handle->buf)) || (gzfread(handle->buf, size, 1, handle->gzfile) != 1) )
+			return -1;
+
+		*atom = (flags & ITEM_FLAG_SHARED)
+			? netatom_deserialize_shared(handle->netatom, handle->buf, size)
+			: netatom_deserialize(handle->netatom, handle->buf, size);
+		*track = ITEM_TRACK(flags);
+
+		if(*atom)
+			return 0;
+	}
+
+	return -1;
+}
+
+// upper bound of events and their padded atoms from seek index, as blocks
+// are limited in size and items never shrink when decoded
+static inline int
+_capsule_bound(plughandle_t *handle, size_t *n, size_t *size)
+{
+	if(!handle->index.n)
+		return -1;
+
+	*n = 0;
+	for(size_t i = 0; i < handle->index.n; i++)
+		*n += handle->index.entries[i].count;
+	*size = handle->index.n * BLOCK_SIZE;
+
+	return 0;
+}
+
+// exact number of events and size of their padded atoms by decoding once
+static inline int
+_capsule_measure(plughandle_t *handle, size_t *n, size_t *size)
+{
+	double beats;
+	uint32_t track;
+	const LV2_Atom *atom;
+
+	*n = 0;
+	*size = 0;
+	while(_fetch(handle, &beats, &track, &atom) == 0)
+	{
+		*n += 1;
+		*size += lv2_atom_pad_size(lv2_atom_total_size(atom));
+	}
+
+	_reopen_disk(handle, false, 0.0); // rewind
+	return (handle->fd == -1) ? -1 : 0;
+}
+
+// decode events straight into capsule sized for at most n events and size
+// bytes of atoms, fails if recording turns out to be bigger
+static inline int
+_capsule_fill(plughandle_t *handle, capsule_t *capsule, size_t n, size_t size)
+{
+	uint8_t *body = (uint8_t *)&capsule->events[n];
+	size_t i = 0;
+	size_t offset = 0;
+
+	double beats;
+	uint32_t track;
+	const LV2_Atom *atom;
+	while(_fetch(handle, &beats, &track, &atom) == 0)
+	{
+		const size_t atom_size = lv2_atom_pad_size(lv2_atom_total_size(atom));
+
+		if( (i >= n) || (offset + atom_size > size) )
+			return -1;
+
+		capsule->events[i].beats = beats;
+		capsule->events[i].offset = offset;
+		capsule->events[i].track = track;
+		memcpy(&body[offset], atom, lv2_atom_total_size(atom));
+		i += 1;
+		offset += atom_size;
+	}
+
+	// atoms follow events directly
+	if(i < n)
+		memmove(&capsule->events[i], body, offset);
+
+	capsule->n = i;
+	capsule->size = sizeof(capsule_t) + i * sizeof(event_t) + offset;
+
+	return 0;
+}
+
+// load whole recording into a single memory block, sized up front
+static inline capsule_t *
+_capsule_load(plughandle_t *handle)
+{
+	_reopen_disk(handle, false, 0.0); // finalizes recording, if any
+	if(handle->fd == -1)
+		return NULL;
+
+	size_t n;
+	size_t size;
+	bool exact = false;
+	if(  (_capsule_bound(handle, &n, &size) != 0)
+		|| (n * sizeof(event_t) + size > MAX_CAPSULE) )
+	{
+		if(_capsule_measure(handle, &n, &size) != 0)
+			return NULL;
+		exact = true;
+	}
+
+	while(true)
+	{
+		if(n * sizeof(event_t) + size > MAX_CAPSULE)
+		{
+			if(handle->log)
+			{
+				lv2_log_note(&handle->logger, "%s: too big for memory: '%s'\n",
+					__func__, handle->file_path);
+			}
+			return NULL;
+		}
+
+		// untouched pages of an overestimated block are never committed
+		capsule_t *capsule = malloc(sizeof(capsule_t) + n * sizeof(event_t) + size);
+		if(!capsule)
+			return NULL;
+
+		if(_capsule_fill(handle, capsule, n, size) == 0)
+		{
+			// give back overestimate, shrinks in place
+			capsule_t *_capsule = realloc(capsule, capsule->size);
+			if(_capsule)
+				capsule = _capsule;
+
+			if( (mlock(capsule, capsule->size) != 0) && handle->log)
+			{
+				lv2_log_note(&handle->logger, "%s: mlock failed: %s\n",
+					__func__, strerror(errno));
+			}
+
+			return capsule;
+		}
+
+		free(capsule);
+		if(exact) // recording changed under our feet
+			return NULL;
+
+		// index does not cover whole recording, e.g. recovered from checkpoint
+		_reopen_disk(handle, false, 0.0);
+		if( (handle->fd == -1) || (_capsule_measure(handle, &n, &size) != 0) )
+			return NULL;
+		exact = true;
+	}
+}
+
+static inline void
+_capsule_free(capsule_t *capsule)
+{
+	munlock(capsule, capsule->size);
+	free(capsule);
+}
+
+// find offset of block to start decoding from and load complete dictionary
+// from index of next recording, if properly closed, decoding must stop after
+// given number of events, where the following block lies elsewhere in the file
+static inline off_t
+_preload_index(plughandle_t *handle, int fd, double beats, uint64_t *events,
+	double *end)
+{
+	*events = UINT64_MAX;
+	*end = INFINITY;
+
+	uint8_t tail [sizeof(footer_t) + GZIP_TRAILER_SIZE];
+	const off_t size = lseek(fd, 0, SEEK_END);
+	if(size < (off_t)sizeof(tail))
+		return 0;
+
+	footer_t footer;
+	if(  (lseek(fd, size - sizeof(tail), SEEK_SET) == -1)
+		|| (read(fd, tail, sizeof(tail)) != sizeof(tail))
+		|| (_footer_find(tail, &footer) != 0) )
+		return 0;
+
+	const uint32_t version = be32toh(footer.version);
+	const off_t index = be64toh(footer.index);
+	if(  (version < 1) || (version > FORMAT_VERSION) || (index >= size)
+		|| (lseek(fd, index, SEEK_SET) == -1) )
+		return 0;
+
+	gzFile gzfile = gzdopen(dup(fd), reading_mode);
+	if(!gzfile)
+		return 0;
+
+	item_t itm;
+	uint32_t n;
+	if(  (gzfread(&itm, sizeof(item_t), 1, gzfile) != 1)
+		|| (itm.size != 0)
+		|| (gzfread(&n, sizeof(uint32_t), 1, gzfile) != 1) )
+	{
+		gzclose(gzfile);
+		return 0;
+	}
+
+	// last block starting before given beats, and the blocks right behind it
+	const size_t entry_size = _entry_size(version);
+	off_t offset = 0;
+	entry_t prev = {
+		.size = 0
+	};
+	n = be32toh(n);
+	for(uint32_t i = 0; i < n; i++)
+	{
+		entry_t entry = {
+			.size = 0
+		};
+		if(gzfread(&entry, entry_size, 1, gzfile) != 1)
+		{
+			gzclose(gzfile);
+			*events = (version < 3) ? UINT64_MAX : 0; // blocks may be out of order
+			*end = INFINITY;
+			return 0;
+		}
+
+		if( (i == 0) || (_double_from_be(&entry.beats) < beats) )
+		{
+			offset = be64toh(entry.offset);
+			*events = be32toh(entry.count);
+		}
+		else if( (*end == INFINITY) && prev.size
+			&& (be64toh(entry.offset) != be64toh(prev.offset) + be32toh(prev.size)) )
+		{
+			*end = _double_from_be(&entry.beats);
+		}
+		else if(*end == INFINITY)
+		{
+			*events += be32toh(entry.count);
+		}
+
+		prev = entry;
+	}
+	if(*end == INFINITY)
+		*events = UINT64_MAX; // runs up to end of recording
+
+	// complete shared dictionary, else scan for it from the start
+	uint32_t dict_size;
+	if(  (gzfread(&dict_size, sizeof(uint32_t), 1, gzfile) == 1)
+		&& ( ( (dict_size = be32toh(dict_size)) > MAX_DICT)
+			|| (gzfread(handle->dict, dict_size, 1, gzfile) != 1)
+			|| (_dict_parse(handle->next_netatom, handle->dict, dict_size) != 0) ) )
+	{
+		netatom_shared_reset(handle->next_netatom);
+		offset = 0;
+		*events = (version < 3) ? UINT64_MAX : 0; // blocks may be out of order
+		*end = INFINITY;
+	}
+
+	gzclose(gzfile);
+
+	return offset;
+}
+
+// decode head of next recording into pre-roll, independent of current stream
+static inline int
+_preload(plughandle_t *handle, const job_t *job, cue_t *cue)
+{
+	const double shift = _loop_shift(job->loop.start, job->loop.end, job->beats);
+	const double from = job->beats - shift;
+
+	const int fd = open(job->file_path, O_RDONLY | O_BINARY);
+	if(fd == -1)
+		return -1;
+
+	struct stat st;
+	if( (fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) )
+	{
+		close(fd);
+		return -1;
+	}
+
+	netatom_shared_reset(handle->next_netatom);
+	uint64_t events;
+	double end;
+	const off_t offset = _preload_index(handle, fd, from, &events, &end);
+
+	double until = fmin(from + CUE_BEATS, end); // stream takes over at next seek
+	if( (job->loop.end > job->loop.start) && (from < job->loop.end) )
+		until = fmin(until, job->loop.end); // stream wraps around from there
+
+	cue->beats = job->beats;
+	cue->until = until + shift;
+	cue->used = 0;
+	cue->n = 0;
+	cue->size = 0;
+
+	gzFile gzfile = (lseek(fd, offset, SEEK_SET) != -1)
+		? gzdopen(fd, reading_mode)
+		: NULL;
+	if(!gzfile)
+	{
+		close(fd);
+		return -1;
+	}
+
+	int res = 0;
+	item_t itm;
+	while( events && (gzfread(&itm, sizeof(item_t), 1, gzfile) == 1) )
+	{
+		const double beats = _double_from_be(&itm.beats);
+		const uint32_t flags = be32toh(itm.size);
+		const uint32_t size = ITEM_SIZE(flags);
 
-		if(gzfread(job->atom, tx_size, 1, handle->gzfile) != 1)
+		if(flags == 0) // end-of-data marker
+			break;
+
+		if(ITEM_IS_EVENT(flags) && (events != UINT64_MAX) )
+			events -= 1;
+
+		if(flags & ITEM_FLAG_DICT)
 		{
-			int errnum;
-			const char *err = gzerror(handle->gzfile, &errnum);
-			if( (errnum != Z_OK) && handle->log)
+			if(  (size > MAX_DICT) || (gzfread(handle->dict, size, 1, gzfile) != 1)
+				|| (_dict_parse(handle->next_netatom, handle->dict, size) != 0) )
 			{
-				lv2_log_error(&handle->logger, "%s: gzfread failed: %s\n", __func__, err);
+				res = -1;
+				break;
 			}
-			return -1;
+
+			continue;
 		}
 
-		const LV2_Atom *atom = netatom_deserialize(handle->netatom, (uint8_t *)job->atom, tx_size);
-		if(atom)
+		const bool wanted = ITEM_IS_EVENT(flags) && (beats >= from)
+			&& !(job->muted & (1U << ITEM_TRACK(flags)));
+		if(wanted && (beats >= until) )
+			break;
+
+		if(!wanted || (size > sizeof(handle->buf)) )
 		{
-			const uint32_t atom_size = lv2_atom_total_size(atom);
-			memcpy(job->atom, atom, atom_size);
+			if(gzseek(gzfile, size, SEEK_CUR) == -1)
+			{
+				res = -1;
+				break;
+			}
 
-			varchunk_write_advance(handle->to_dsp, sizeof(job_t) + atom_size);
-			return 0;
+			continue;
 		}
-		else if(handle->log)
+
+		if(gzfread(handle->buf, size, 1, gzfile) != 1)
 		{
-			lv2_log_error(&handle->logger, "%s: netatom_deserialize failed\n", __func__);
+			res = -1;
+			break;
 		}
-	}
-	else if(handle->log)
-	{
-		lv2_log_error(&handle->logger, "%s: ringbuffer overflow\n", __func__);
+
+		const LV2_Atom *atom = (flags & ITEM_FLAG_SHARED)
+			? netatom_deserialize_shared(handle->next_netatom, handle->buf, size)
+			: netatom_deserialize(handle->next_netatom, handle->buf, size);
+		if(!atom)
+			continue;
+
+		// truncate pre-roll when full, stream takes over from there
+		const size_t atom_size = lv2_atom_total_size(atom);
+		if( (cue->n == CUE_EVENTS) || (cue->size + atom_size > CUE_SIZE) )
+		{
+			cue->until = beats + shift;
+			break;
+		}
+
+		event_t *ev = &cue->events[cue->n++];
+		ev->beats = beats + shift;
+		ev->offset = cue->size;
+		ev->track = ITEM_TRACK(flags);
+
+		memcpy(&cue->body[cue->size], atom, atom_size);
+		cue->size += lv2_atom_pad_size(atom_size);
 	}
 
-	return -1;
+	gzclose(gzfile);
+
+	return res;
 }
 
 static LV2_Handle
@@ -614,6 +4086,10 @@ instantiate(const LV2_Descriptor* descriptor, double rate,
 		return NULL;
 	mlock(handle, sizeof(plughandle_t));
 
+	handle->fd = -1;
+	handle->last = -INFINITY;
+	handle->rate = rate;
+
 	for(unsigned i=0; features[i]; i++)
 	{
 		if(!strcmp(features[i]->URI, LV2_URID__map))
@@ -660,27 +4136,41 @@ instantiate(const LV2_Descriptor* descriptor, double rate,
 		return NULL;
 	}
 
-	handle->to_worker = varchunk_new(0x100000, true); // 1M
+	handle->next_netatom = netatom_new(handle->map, handle->unmap, true);
+	if(!handle->next_netatom)
+	{
+		netatom_free(handle->netatom);
+		free(handle);
+		return NULL;
+	}
+
+	handle->to_worker = varchunk_new(RINGBUFFER_SIZE, true);
 	if(!handle->to_worker)
 	{
 		fprintf(stderr,
 			"%s: Failed to initialize ringbuffer\n", descriptor->URI);
+		netatom_free(handle->next_netatom);
 		netatom_free(handle->netatom);
 		free(handle);
 		return NULL;
 	}
 
-	handle->to_dsp = varchunk_new(0x100000, true); // 1M
+	handle->to_dsp = varchunk_new(RINGBUFFER_SIZE, true);
 	if(!handle->to_dsp)
 	{
 		fprintf(stderr,
 			"%s: Failed to initialize ringbuffer\n", descriptor->URI);
 		varchunk_free(handle->to_worker);
+		netatom_free(handle->next_netatom);
 		netatom_free(handle->netatom);
 		free(handle);
 		return NULL;
 	}
 
+#if defined(USE_IO_THREAD)
+	handle->thread.responses = varchunk_new(RESPONSES_SIZE, true); // else host worker
+#endif
+
 	lv2_atom_forge_init(&handle->forge, handle->map);
 
 	timely_mask_t mask = TIMELY_MASK_BAR_BEAT
@@ -705,6 +4195,24 @@ instantiate(const LV2_Descriptor* descriptor, double rate,
 	handle->urid.record = props_map(&handle->props, ORBIT_URI"#timecapsule_record");
 	handle->urid.mute_toggle = props_map(&handle->props, ORBIT_URI"#timecapsule_mute_toggle");
 	handle->urid.record_toggle = props_map(&handle->props, ORBIT_URI"#timecapsule_record_toggle");
+	handle->urid.file_path = props_map(&handle->props, ORBIT_URI"#timecapsule_file_path");
+	handle->urid.next_path = props_map(&handle->props, ORBIT_URI"#timecapsule_next_path");
+	handle->urid.events = props_map(&handle->props, ORBIT_URI"#timecapsule_events");
+	handle->urid.first = props_map(&handle->props, ORBIT_URI"#timecapsule_first");
+	handle->urid.last = props_map(&handle->props, ORBIT_URI"#timecapsule_last");
+	handle->urid.rate = props_map(&handle->props, ORBIT_URI"#timecapsule_rate");
+	handle->urid.bpm = props_map(&handle->props, ORBIT_URI"#timecapsule_bpm");
+	handle->urid.late = props_map(&handle->props, ORBIT_URI"#timecapsule_late");
+	handle->urid.dropped = props_map(&handle->props, ORBIT_URI"#timecapsule_dropped");
+	handle->urid.lateness = props_map(&handle->props, ORBIT_URI"#timecapsule_lateness");
+	handle->urid.written = props_map(&handle->props, ORBIT_URI"#timecapsule_written");
+	handle->urid.read = props_map(&handle->props, ORBIT_URI"#timecapsule_read");
+	handle->urid.ratio = props_map(&handle->props, ORBIT_URI"#timecapsule_ratio");
+	handle->urid.job_latency = props_map(&handle->props, ORBIT_URI"#timecapsule_job_latency");
+	handle->urid.fill = props_map(&handle->props, ORBIT_URI"#timecapsule_fill");
+	handle->urid.reposition = props_map(&handle->props, ORBIT_URI"#timecapsule_reposition");
+	handle->urid.overflows = props_map(&handle->props, ORBIT_URI"#timecapsule_overflows");
+	handle->urid.midi_event = handle->map->map(handle->map->handle, LV2_MIDI__MidiEvent);
 
 	return handle;
 }
@@ -739,6 +4247,74 @@ run(LV2_Handle instance, uint32_t nsamples)
 
 	props_idle(&handle->props, &handle->forge, 0, &handle->ref);
 
+	if(handle->notify) // statistics of newly opened recording
+	{
+		props_set(&handle->props, &handle->forge, 0, handle->urid.events, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.first, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.last, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.rate, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.bpm, &handle->ref);
+
+		handle->notify = false;
+	}
+
+	if(handle->timing) // late or dropped events during previous period
+	{
+		props_set(&handle->props, &handle->forge, 0, handle->urid.late, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.dropped, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.lateness, &handle->ref);
+
+		handle->timing = false;
+	}
+
+	if(  (handle->telemetry || (handle->fill != handle->state.fill) ) // changed since last update
+		&& (handle->clock - handle->published >= handle->rate * TELEMETRY_MS / 1000) )
+	{
+		const io_t *disk = &handle->disk;
+
+		handle->state.written = disk->written;
+		handle->state.read = disk->read;
+		handle->state.ratio = disk->compressed
+			? (float)disk->encoded / disk->compressed
+			: 0.f;
+		handle->state.job_latency = handle->latency * 1000.f / handle->rate;
+		handle->state.overflows = handle->overflows + disk->overflows;
+		handle->state.fill = handle->fill;
+
+		props_set(&handle->props, &handle->forge, 0, handle->urid.written, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.read, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.ratio, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.job_latency, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.fill, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.reposition, &handle->ref);
+		props_set(&handle->props, &handle->forge, 0, handle->urid.overflows, &handle->ref);
+
+		handle->fill = 0.f; // peak until next update
+		handle->published = handle->clock;
+		handle->telemetry = false;
+	}
+
+	if(handle->state.next_path[0] && !handle->state.record) // gapless switch pending
+	{
+		const double beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
+
+		if(!isfinite(beats))
+		{
+			// wait for transport position
+		}
+		else if(handle->next_ready)
+		{
+			if(beats >= handle->next.until) // jumped past it, preload again
+				handle->next_ready = handle->next_pending = false;
+			else if(beats >= handle->next_beats)
+				_next_switch(handle, beats);
+		}
+		else if(!handle->next_pending && (handle->capsule || (handle->cue != &handle->next) ) )
+		{
+			_request_preload(handle, beats); // not while still playing from it
+		}
+	}
+
 	int64_t last_t = 0;
 	LV2_ATOM_SEQUENCE_FOREACH(handle->event_in, ev)
 	{
@@ -768,6 +4344,22 @@ run(LV2_Handle instance, uint32_t nsamples)
 	if(handle->rolling && !handle->state.record && !handle->state.mute)
 		_play(handle, nsamples);
 
+	handle->clock += nsamples;
+
+	// peak fill level of either ringbuffer, in percent
+	const size_t to_worker = varchunk_read_space(handle->to_worker);
+	const size_t to_dsp = varchunk_read_space(handle->to_dsp);
+	const float fill = ( (to_worker > to_dsp) ? to_worker : to_dsp) * 100.f / RINGBUFFER_SIZE;
+	if(fill > handle->fill)
+		handle->fill = fill;
+
+	// flush recording periodically, so it can be recovered after a crash
+	if(  handle->state.record && (handle->state.checkpoint > 0.f)
+		&& (handle->clock - handle->checkpointed >= handle->state.checkpoint * handle->rate) )
+	{
+		_request_checkpoint(handle);
+	}
+
 	if(handle->ref)
 		lv2_atom_forge_pop(&handle->forge, &frame);
 	else
@@ -786,15 +4378,59 @@ cleanup(LV2_Handle instance)
 
 	_close_disk(handle);
 
+	if(handle->pool)
+		_pool_free(handle->pool);
+
+	if(handle->capsule)
+		_capsule_free(handle->capsule);
+
+	if(handle->to_worker)
+	{
+		// free capsules still queued for the worker
+		const job_t *job;
+		size_t tot_size;
+		while((job = varchunk_read_request(handle->to_worker, &tot_size)))
+		{
+			if(job->type == TC_JOB_FREE)
+				_capsule_free(job->capsule);
+
+			varchunk_read_advance(handle->to_worker);
+		}
+	}
+
 	if(handle->to_dsp)
 		varchunk_free(handle->to_dsp);
 
 	if(handle->to_worker)
 		varchunk_free(handle->to_worker);
 
+#if defined(USE_IO_THREAD)
+	if(handle->thread.responses)
+	{
+		// free capsules of undelivered responses
+		const job_t *job;
+		size_t tot_size;
+		while((job = varchunk_read_request(handle->thread.responses, &tot_size)))
+		{
+			if( (job->type == TC_JOB_LOAD) && job->capsule)
+				_capsule_free(job->capsule);
+
+			varchunk_read_advance(handle->thread.responses);
+		}
+
+		varchunk_free(handle->thread.responses);
+	}
+#endif
+
 	if(handle->netatom)
 		netatom_free(handle->netatom);
 
+	if(handle->next_netatom)
+		netatom_free(handle->next_netatom);
+
+	if(handle->index.entries)
+		free(handle->index.entries);
+
 	munlock(handle, sizeof(plughandle_t));
 	free(handle);
 }
@@ -824,6 +4460,27 @@ static const LV2_State_Interface state_iface = {
 	.restore = _state_restore
 };
 
+// non-rt thread
+static inline void
+_drain(plughandle_t *handle, uint32_t drain)
+{
+	job_t *job;
+	if((job = varchunk_write_request(handle->to_dsp, sizeof(job_t))))
+	{
+		job->type = TC_JOB_DRAIN;
+		job->seq = drain;
+
+		varchunk_write_advance(handle->to_dsp, sizeof(job_t));
+	}
+	else
+	{
+		handle->io.overflows += 1;
+
+		if(handle->log)
+			lv2_log_error(&handle->logger, "%s: ringbuffer overflow\n", __func__);
+	}
+}
+
 // non-rt thread
 static LV2_Worker_Status
 _work(LV2_Handle instance,
@@ -843,58 +4500,112 @@ _work(LV2_Handle instance,
 		{
 			case TC_JOB_REPOSITION_PLAY:
 			{
-				_reopen_disk(handle, false, job->beats);
+				handle->punch.until = fmax(handle->punch.until, job->beats); // recording stopped here
+				_loop_set(handle, job);
+				_reopen_disk(handle, false, job->beats - handle->loop.shift);
 
-				// send drain
-				job_t *job2;
-				if((job2 = varchunk_write_request(handle->to_dsp, sizeof(job_t))))
-				{
-					job2->type = TC_JOB_DRAIN;
-
-					varchunk_write_advance(handle->to_dsp, sizeof(job_t));
-				}
-				else if(handle->log)
-				{
-					lv2_log_error(&handle->logger, "%s: ringbuffer overflow\n", __func__);
-				}
+				_drain(handle, job->seq);
 			} // fall-through
 			case TC_JOB_READ:
 			{
-				while(_read_from(handle) == 0)
-					;
+				const job_t resp = {
+					.type = TC_JOB_READ,
+					.seq = job->seq,
+					.beats = _read_ahead(handle, job->until)
+				};
+
+				if(respond(worker, sizeof(job_t), &resp) != LV2_WORKER_SUCCESS)
+				{
+					handle->io.overflows += 1; // response lost
+					if(handle->log)
+						lv2_log_error(&handle->logger, "%s: respond failed\n", __func__);
+				}
 			} break;
 
 			case TC_JOB_REPOSITION_REC:
 			{
+				handle->punch.until = fmax(handle->punch.until, job->until);
+				handle->compression = job->compression;
+				handle->bpm = job->bpm;
 				_reopen_disk(handle, true, job->beats);
 
-				// send drain
-				job_t *job2;
-				if((job2 = varchunk_write_request(handle->to_dsp, sizeof(job_t))))
-				{
-					job2->type = TC_JOB_DRAIN;
-
-					varchunk_write_advance(handle->to_dsp, sizeof(job_t));
-				}
-				else if(handle->log)
-				{
-					lv2_log_error(&handle->logger, "%s: ringbuffer overflow\n", __func__);
-				}
+				_drain(handle, job->seq);
 			} break;
 
 			case TC_JOB_WRITE:
 			{
-				_write_to(handle, job->beats, job->atom);
+				_write_to(handle, job->beats, job->track, job->atom);
+			} break;
+
+			case TC_JOB_CHECKPOINT:
+			{
+				if( (_checkpoint_write(handle) != 0) && handle->log)
+				{
+					lv2_log_error(&handle->logger, "%s: checkpoint failed: %s '%s'\n",
+						__func__, handle->file_path, strerror(errno));
+				}
 			} break;
 
 			case TC_JOB_CHANGE_PATH:
 			{
+				handle->punch.until = fmax(handle->punch.until, job->beats);
 				_close_disk(handle);
 				strncpy(handle->file_path, job->file_path, PATH_MAX - 1);
-				_reopen_disk(handle, false, job->beats); // open readonly by default FIXME
+				_loop_set(handle, job);
+				_reopen_disk(handle, false, job->beats - handle->loop.shift); // open readonly by default FIXME
+				_drain(handle, job->seq);
+			} break;
+
+			case TC_JOB_LOAD:
+			{
+				const job_t resp = {
+					.type = TC_JOB_LOAD,
+					.seq = job->seq,
+					.capsule = _capsule_load(handle)
+				};
+
+				if(respond(worker, sizeof(job_t), &resp) != LV2_WORKER_SUCCESS)
+				{
+					handle->io.overflows += 1; // response lost
+					if(resp.capsule)
+						_capsule_free(resp.capsule);
+					if(handle->log)
+						lv2_log_error(&handle->logger, "%s: respond failed\n", __func__);
+				}
+			} break;
+
+			case TC_JOB_FREE:
+			{
+				_capsule_free(job->capsule);
+			} break;
+
+			case TC_JOB_PRELOAD:
+			{
+				const job_t resp = {
+					.type = TC_JOB_PRELOAD,
+					.seq = job->seq,
+					.beats = job->beats
+				};
+
+				handle->next.valid = (_preload(handle, job, &handle->next) == 0);
+				if(!handle->next.valid && handle->log)
+				{
+					lv2_log_note(&handle->logger, "%s: preloading failed: '%s'\n",
+						__func__, job->file_path);
+				}
+
+				if(respond(worker, sizeof(job_t), &resp) != LV2_WORKER_SUCCESS)
+				{
+					handle->io.overflows += 1; // response lost
+					if(handle->log)
+						lv2_log_error(&handle->logger, "%s: respond failed\n", __func__);
+				}
 			} break;
 
+			case TC_JOB_MAPPED:
 			case TC_JOB_DRAIN:
+			case TC_JOB_STATS:
+			case TC_JOB_IO:
 			{
 				// nothing to do
 			}	break;
@@ -903,6 +4614,30 @@ _work(LV2_Handle instance,
 		varchunk_read_advance(handle->to_worker);
 	}
 
+	if(handle->report)
+	{
+		const report_t report = {
+			.type = TC_JOB_STATS,
+			.stats = handle->stats
+		};
+
+		if(respond(worker, sizeof(report_t), &report) == LV2_WORKER_SUCCESS)
+			handle->report = false;
+		else if(handle->log)
+			lv2_log_error(&handle->logger, "%s: respond failed\n", __func__);
+	}
+
+	if(memcmp(&handle->io, &handle->reported, sizeof(io_t)))
+	{
+		const report_t report = {
+			.type = TC_JOB_IO,
+			.io = handle->io
+		};
+
+		if(respond(worker, sizeof(report_t), &report) == LV2_WORKER_SUCCESS)
+			handle->reported = handle->io;
+	}
+
 	return LV2_WORKER_SUCCESS;
 }
 
@@ -911,16 +4646,217 @@ static LV2_Worker_Status
 _work_response(LV2_Handle instance, uint32_t size, const void *body)
 {
 	plughandle_t *handle = instance;
+	const job_t *job = body;
+
+	if(job->type == TC_JOB_STATS)
+	{
+		const report_t *report = body;
+
+		handle->state.events = report->stats.events;
+		handle->state.first = report->stats.first;
+		handle->state.last = report->stats.last;
+		handle->state.rate = report->stats.rate;
+		handle->state.bpm = report->stats.bpm;
+		handle->notify = true;
+
+		return LV2_WORKER_SUCCESS;
+	}
+
+	if(job->type == TC_JOB_PRELOAD)
+	{
+		if(job->seq != handle->next_seq)
+			return LV2_WORKER_SUCCESS; // outdated by another next path
+
+		// on failure, stay pending until another next path is given
+		if(handle->next.valid)
+		{
+			handle->next_beats = job->beats;
+			handle->next_pending = false;
+			handle->next_ready = true;
+		}
+
+		return LV2_WORKER_SUCCESS;
+	}
+
+	if(job->type == TC_JOB_IO)
+	{
+		const report_t *report = body;
+
+		handle->disk = report->io;
+		handle->telemetry = true;
+
+		return LV2_WORKER_SUCCESS;
+	}
+
+	if(job->type == TC_JOB_READ)
+	{
+		if(job->seq != handle->drain)
+			return LV2_WORKER_SUCCESS; // outdated by reposition
+
+		// track worst recent round-trip, decaying slowly
+		const double latency = handle->clock - handle->requested;
+		handle->latency = fmax(latency, handle->latency * 0.9);
+
+		if(job->beats > handle->horizon)
+			handle->horizon = job->beats;
+		handle->reading = false;
+
+		return LV2_WORKER_SUCCESS;
+	}
+
+	if(job->type != TC_JOB_LOAD)
+		return LV2_WORKER_SUCCESS;
+
+	_capsule_release(handle);
+	handle->capsule = job->capsule;
+
+	// outdated or no longer wanted
+	if( (job->seq != handle->load) || !handle->state.memory || handle->state.record)
+	{
+		_capsule_release(handle);
+		return LV2_WORKER_SUCCESS;
+	}
+
+	const double beats = handle->offset / TIMELY_FRAMES_PER_BEAT(&handle->timely);
+	if(handle->capsule)
+		_capsule_seek(handle, isfinite(beats) ? beats : 0.0);
+	else if(isfinite(beats)) // loading failed, keep on streaming
+		_reposition_play(handle, beats);
+
+	return LV2_WORKER_SUCCESS;
+}
+
+// rt-thread, wake worker at most once per cycle, it drains all pending jobs
+static LV2_Worker_Status
+_end_run(LV2_Handle instance)
+{
+	plughandle_t *handle = instance;
+
+#if defined(USE_IO_THREAD)
+	if(handle->thread.running)
+	{
+		const void *body;
+		size_t size;
+		while((body = varchunk_read_request(handle->thread.responses, &size)))
+		{
+			_work_response(handle, size, body);
+			varchunk_read_advance(handle->thread.responses);
+		}
+
+		if(handle->wakeup)
+		{
+			sem_post(&handle->thread.sem);
+			handle->wakeup = false;
+		}
+
+		return LV2_WORKER_SUCCESS;
+	}
+#endif
+
+	if(!handle->wakeup)
+		return LV2_WORKER_SUCCESS;
+
+	const int32_t dummy = 0;
+
+	const LV2_Worker_Status status = handle->sched->schedule_work(
+		handle->sched->handle, sizeof(int32_t), &dummy);
+	if(status == LV2_WORKER_SUCCESS)
+	{
+		handle->wakeup = false;
+	}
+	else if(handle->log)
+	{
+		lv2_log_trace(&handle->logger, "%s: work:schedule failed\n", __func__);
+	}
+
+	return status;
+}
 
-	// nothing
+#if defined(USE_IO_THREAD)
+// i/o thread, queue response for rt-thread
+static LV2_Worker_Status
+_respond(LV2_Worker_Respond_Handle target, uint32_t size, const void *data)
+{
+	plughandle_t *handle = target;
+
+	void *dst;
+	if(!(dst = varchunk_write_request(handle->thread.responses, size)))
+		return LV2_WORKER_ERR_NO_SPACE;
+
+	memcpy(dst, data, size);
+	varchunk_write_advance(handle->thread.responses, size);
 
 	return LV2_WORKER_SUCCESS;
 }
 
+// i/o thread, drains all pending jobs per wakeup, just like the host worker
+static void *
+_io_thread(void *data)
+{
+	plughandle_t *handle = data;
+
+	while(true)
+	{
+		if(sem_wait(&handle->thread.sem) != 0)
+			continue; // interrupted
+
+		if(atomic_load(&handle->thread.done))
+			break;
+
+		_work(handle, _respond, handle, 0, NULL);
+	}
+
+	return NULL;
+}
+#endif
+
+static void
+activate(LV2_Handle instance)
+{
+#if defined(USE_IO_THREAD)
+	plughandle_t *handle = instance;
+
+	if(!handle->thread.responses || handle->thread.running)
+		return;
+
+	atomic_init(&handle->thread.done, false);
+	if(sem_init(&handle->thread.sem, 0, 0) != 0)
+		return;
+
+	if(pthread_create(&handle->thread.id, NULL, _io_thread, handle) != 0)
+	{
+		sem_destroy(&handle->thread.sem);
+		if(handle->log)
+			lv2_log_note(&handle->logger, "%s: using host worker\n", __func__);
+		return;
+	}
+
+	handle->thread.running = true;
+#endif
+}
+
+static void
+deactivate(LV2_Handle instance)
+{
+#if defined(USE_IO_THREAD)
+	plughandle_t *handle = instance;
+
+	if(!handle->thread.running)
+		return;
+
+	atomic_store(&handle->thread.done, true);
+	sem_post(&handle->thread.sem);
+	pthread_join(handle->thread.id, NULL);
+	sem_destroy(&handle->thread.sem);
+
+	handle->thread.running = false;
+#endif
+}
+
 static const LV2_Worker_Interface work_iface = {
 	.work = _work,
 	.work_response = _work_response,
-	.end_run = NULL
+	.end_run = _end_run
 };
 
 static const void *
@@ -937,9 +4873,9 @@ const LV2_Descriptor orbit_timecapsule = {
 	.URI						= ORBIT_TIMECAPSULE_URI,
 	.instantiate		= instantiate,
 	.connect_port		= connect_port,
-	.activate				= NULL,
+	.activate				= activate,
 	.run						= run,
-	.deactivate			= NULL,
+	.deactivate			= deactivate,
 	.cleanup				= cleanup,
 	.extension_data	= extension_data
 };
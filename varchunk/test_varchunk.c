@@ -137,6 +137,38 @@ test_threaded()
 	varchunk_free(varchunk);
 }
 
+static void
+test_space()
+{
+	varchunk_t *varchunk = varchunk_new(8192, false);
+	assert(varchunk);
+	assert(varchunk_read_space(varchunk) == 0);
+
+	for(unsigned i = 0; i < 2048; i++)
+	{
+		const size_t written = PAD(rand() * 1024.f / RAND_MAX);
+
+		if(varchunk_write_request(varchunk, written))
+		{
+			varchunk_write_advance(varchunk, written);
+			assert(varchunk_read_space(varchunk) >= written + sizeof(varchunk_elmnt_t));
+		}
+
+		size_t toread;
+		if( (i % 3) && varchunk_read_request(varchunk, &toread) )
+			varchunk_read_advance(varchunk);
+
+		assert(varchunk_read_space(varchunk) < varchunk->size);
+	}
+
+	size_t toread;
+	while(varchunk_read_request(varchunk, &toread))
+		varchunk_read_advance(varchunk);
+	assert(varchunk_read_space(varchunk) == 0);
+
+	varchunk_free(varchunk);
+}
+
 #if defined(VARCHUNK_USE_SHARED_MEM)
 typedef struct _varchunk_shm_t varchunk_shm_t;
 
@@ -244,6 +276,7 @@ main(int argc, char **argv)
 
 	assert(varchunk_is_lock_free());
 
+	test_space();
 	test_threaded();
 
 #if defined(VARCHUNK_USE_SHARED_MEM)
@@ -68,6 +68,9 @@ varchunk_read_request(varchunk_t *varchunk, size_t *toread);
 static inline void
 varchunk_read_advance(varchunk_t *varchunk);
 
+static inline size_t
+varchunk_read_space(varchunk_t *varchunk);
+
 /*****************************************************************************
  * API END
  *****************************************************************************/
@@ -375,6 +378,18 @@ varchunk_read_advance(varchunk_t *varchunk)
 		sizeof(varchunk_elmnt_t) + VARCHUNK_PAD(elmnt->size));
 }
 
+static inline size_t
+varchunk_read_space(varchunk_t *varchunk)
+{
+	assert(varchunk);
+	// may be called from either side, thus only an estimate while in flux
+	const size_t tail = atomic_load_explicit(&varchunk->tail, varchunk->acquire);
+	const size_t head = atomic_load_explicit(&varchunk->head, varchunk->acquire);
+
+	// includes element headers, padding and gaps
+	return (head - tail + varchunk->size) & varchunk->mask;
+}
+
 #undef VARCHUNK_PAD
 
 #ifdef __cplusplus